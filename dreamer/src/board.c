@@ -27,6 +27,7 @@
 #include "board.h"
 #include "hashing.h"
 #include "move.h"
+#include "nnue.h"
 
 /* square_bit[i] is a bitboard that marks square 'i' on the board. */
 bitboard_t square_bit[64];
@@ -34,6 +35,117 @@ bitboard_t square_bit[64];
 /* Pieces values are used to calculate the material balance of the board. */
 static int piece_value[] = {100, 100, 300, 300, 350, 350, 500, 500, 900, 900, 2000, 2000};
 
+/* Contribution of each piece to the game phase. */
+static int piece_phase[] = {0, 0, 1, 1, 1, 1, 2, 2, 4, 4, 0, 0};
+
+/* Middlegame and endgame piece-square tables for white pawns, knights,
+** bishops, rooks, queens and kings, from A1 to H8. The tables for black are
+** mirrored by board_init().
+*/
+static const int pst_mg_white[6][64] = {
+	{0, 0, 0, 0, 0, 0, 0, 0,
+	 0, 0, 0, -15, -15, 0, 0, 0,
+	 0, 0, 2, 4, 4, 2, 0, 0,
+	 0, 0, 5, 12, 12, 5, 0, 0,
+	 2, 2, 6, 14, 14, 6, 2, 2,
+	 6, 6, 10, 16, 16, 10, 6, 6,
+	 10, 10, 12, 16, 16, 12, 10, 10,
+	 0, 0, 0, 0, 0, 0, 0, 0},
+	{-20, -20, -15, -15, -15, -15, -20, -20,
+	 -10, -5, 0, 0, 0, 0, -5, -10,
+	 -8, 0, 4, 6, 6, 4, 0, -8,
+	 -6, 2, 6, 10, 10, 6, 2, -6,
+	 -6, 2, 8, 12, 12, 8, 2, -6,
+	 -8, 0, 6, 8, 8, 6, 0, -8,
+	 -10, -5, 0, 2, 2, 0, -5, -10,
+	 -15, -10, -8, -6, -6, -8, -10, -15},
+	{-14, -12, -12, -10, -10, -12, -12, -14,
+	 -4, 4, 0, 2, 2, 0, 4, -4,
+	 -2, 2, 4, 4, 4, 4, 2, -2,
+	 -2, 0, 4, 6, 6, 4, 0, -2,
+	 -2, 2, 4, 6, 6, 4, 2, -2,
+	 -2, 0, 2, 4, 4, 2, 0, -2,
+	 -4, 0, 0, 0, 0, 0, 0, -4,
+	 -6, -4, -4, -4, -4, -4, -4, -6},
+	{0, 0, 2, 4, 4, 2, 0, 0,
+	 -2, 0, 0, 0, 0, 0, 0, -2,
+	 -2, 0, 0, 0, 0, 0, 0, -2,
+	 -2, 0, 0, 0, 0, 0, 0, -2,
+	 -2, 0, 0, 0, 0, 0, 0, -2,
+	 -2, 0, 0, 0, 0, 0, 0, -2,
+	 22, 22, 22, 22, 22, 22, 22, 22,
+	 0, 0, 0, 0, 0, 0, 0, 0},
+	{-4, -2, -2, 0, 0, -2, -2, -4,
+	 -2, 0, 0, 0, 0, 0, 0, -2,
+	 -2, 0, 2, 2, 2, 2, 0, -2,
+	 -2, 0, 2, 2, 2, 2, 0, -2,
+	 -2, 0, 2, 2, 2, 2, 0, -2,
+	 -2, 0, 2, 2, 2, 2, 0, -2,
+	 -2, 0, 0, 0, 0, 0, 0, -2,
+	 -4, -2, -2, -2, -2, -2, -2, -4},
+	{10, 15, 5, 0, 0, 5, 15, 10,
+	 5, 5, -5, -10, -10, -5, 5, 5,
+	 -10, -15, -20, -25, -25, -20, -15, -10,
+	 -25, -25, -30, -30, -30, -30, -25, -25,
+	 -30, -30, -30, -30, -30, -30, -30, -30,
+	 -30, -30, -30, -30, -30, -30, -30, -30,
+	 -30, -30, -30, -30, -30, -30, -30, -30,
+	 -30, -30, -30, -30, -30, -30, -30, -30}};
+
+static const int pst_eg_white[6][64] = {
+	{0, 0, 0, 0, 0, 0, 0, 0,
+	 0, 0, 0, 0, 0, 0, 0, 0,
+	 2, 2, 2, 2, 2, 2, 2, 2,
+	 5, 5, 5, 5, 5, 5, 5, 5,
+	 10, 10, 10, 10, 10, 10, 10, 10,
+	 16, 16, 16, 16, 16, 16, 16, 16,
+	 24, 24, 24, 24, 24, 24, 24, 24,
+	 0, 0, 0, 0, 0, 0, 0, 0},
+	{-15, -10, -8, -6, -6, -8, -10, -15,
+	 -10, -4, 0, 2, 2, 0, -4, -10,
+	 -8, 0, 4, 6, 6, 4, 0, -8,
+	 -6, 2, 6, 8, 8, 6, 2, -6,
+	 -6, 2, 6, 8, 8, 6, 2, -6,
+	 -8, 0, 4, 6, 6, 4, 0, -8,
+	 -10, -4, 0, 2, 2, 0, -4, -10,
+	 -15, -10, -8, -6, -6, -8, -10, -15},
+	{-6, -4, -4, -4, -4, -4, -4, -6,
+	 -4, 0, 0, 0, 0, 0, 0, -4,
+	 -4, 0, 2, 2, 2, 2, 0, -4,
+	 -4, 0, 2, 4, 4, 2, 0, -4,
+	 -4, 0, 2, 4, 4, 2, 0, -4,
+	 -4, 0, 2, 2, 2, 2, 0, -4,
+	 -4, 0, 0, 0, 0, 0, 0, -4,
+	 -6, -4, -4, -4, -4, -4, -4, -6},
+	{0, 0, 0, 0, 0, 0, 0, 0,
+	 0, 0, 0, 0, 0, 0, 0, 0,
+	 0, 0, 0, 0, 0, 0, 0, 0,
+	 0, 0, 0, 0, 0, 0, 0, 0,
+	 0, 0, 0, 0, 0, 0, 0, 0,
+	 0, 0, 0, 0, 0, 0, 0, 0,
+	 16, 16, 16, 16, 16, 16, 16, 16,
+	 0, 0, 0, 0, 0, 0, 0, 0},
+	{-8, -6, -4, -4, -4, -4, -6, -8,
+	 -6, -2, 0, 0, 0, 0, -2, -6,
+	 -4, 0, 4, 4, 4, 4, 0, -4,
+	 -4, 0, 4, 6, 6, 4, 0, -4,
+	 -4, 0, 4, 6, 6, 4, 0, -4,
+	 -4, 0, 4, 4, 4, 4, 0, -4,
+	 -6, -2, 0, 0, 0, 0, -2, -6,
+	 -8, -6, -4, -4, -4, -4, -6, -8},
+	{-30, -20, -15, -10, -10, -15, -20, -30,
+	 -20, -10, 0, 5, 5, 0, -10, -20,
+	 -15, 0, 10, 15, 15, 10, 0, -15,
+	 -10, 5, 15, 20, 20, 15, 5, -10,
+	 -10, 5, 15, 20, 20, 15, 5, -10,
+	 -15, 0, 10, 15, 15, 10, 0, -15,
+	 -20, -10, 0, 5, 5, 0, -10, -20,
+	 -30, -20, -15, -10, -10, -15, -20, -30}};
+
+/* Piece-square tables indexed by piece and square, filled by board_init(). */
+static int pst_mg[NR_PIECES][64];
+static int pst_eg[NR_PIECES][64];
+
 static void add_piece(board_t *board, int square, int piece)
 /* Adds a piece to a board.
 ** Parameters: (board_t *) board: Pointer to the board to add the piece to.
@@ -44,9 +156,18 @@ static void add_piece(board_t *board, int square, int piece)
 	board->bitboard[piece] |= square_bit[square];
 	board->bitboard[ALL + (piece & 1)] |= square_bit[square];
 	board->material_value[piece & 1] += piece_value[piece];
+	board->pst_mg[piece & 1] += pst_mg[piece][square];
+	board->pst_eg[piece & 1] += pst_eg[piece][square];
+	board->phase += piece_phase[piece];
+	board->material_key += MATERIAL_KEY_UNIT(piece);
+
+	if (nnue_enabled)
+		nnue_add_piece(board, square, piece);
 
-	if ((piece & PIECE_MASK) == PAWN)
+	if ((piece & PIECE_MASK) == PAWN) {
 		board->num_pawns[piece & 1]++;
+		board->pawn_hash_key ^= pieces_hash[piece][square];
+	}
 
 	board->hash_key ^= pieces_hash[piece][square];
 }
@@ -62,13 +183,54 @@ static void remove_piece(board_t *board, int square, int piece)
 	board->bitboard[piece] ^= square_bit[square];
 	board->bitboard[ALL + (piece & 1)] ^= square_bit[square];
 	board->material_value[piece & 1] -= piece_value[piece];
+	board->pst_mg[piece & 1] -= pst_mg[piece][square];
+	board->pst_eg[piece & 1] -= pst_eg[piece][square];
+	board->phase -= piece_phase[piece];
+	board->material_key -= MATERIAL_KEY_UNIT(piece);
+
+	if (nnue_enabled)
+		nnue_remove_piece(board, square, piece);
 
-	if ((piece & PIECE_MASK) == PAWN)
+	if ((piece & PIECE_MASK) == PAWN) {
 		board->num_pawns[piece & 1]--;
+		board->pawn_hash_key ^= pieces_hash[piece][square];
+	}
 
 	board->hash_key ^= pieces_hash[piece][square];
 }
 
+void board_set_piece_value(int piece, int value) {
+	piece_value[piece & PIECE_MASK] = value;
+	piece_value[(piece & PIECE_MASK) + 1] = value;
+}
+
+int board_piece_value(int piece) {
+	return piece_value[piece];
+}
+
+int board_piece_phase(int piece) {
+	return piece_phase[piece];
+}
+
+void board_piece_square_totals(const bitboard_t *pieces, int *mg, int *eg) {
+	int piece;
+
+	mg[SIDE_WHITE] = mg[SIDE_BLACK] = 0;
+	eg[SIDE_WHITE] = eg[SIDE_BLACK] = 0;
+
+	for (piece = 0; piece < NR_PIECES; piece++) {
+		bitboard_t bitboard = pieces[piece];
+
+		while (bitboard) {
+			int square = BIT_FIRST(bitboard);
+
+			mg[piece & 1] += pst_mg[piece][square];
+			eg[piece & 1] += pst_eg[piece][square];
+			bitboard &= bitboard - 1;
+		}
+	}
+}
+
 void setup_board(board_t *board) {
 	int i;
 
@@ -109,6 +271,47 @@ void setup_board(board_t *board) {
 	board->fifty_moves = 0;
 }
 
+void setup_board_bitboards(board_t *board, const bitboard_t *pieces, int current_player, int castle_flags) {
+	bitboard_t phantoms[2] = {0, 0};
+	int piece;
+
+	clear_board(board);
+
+	if (castle_flags & WHITE_PHANTOM_KINGS_KINGSIDE)
+		phantoms[SIDE_WHITE] = WHITE_PHANTOM_KINGSIDE;
+	else if (castle_flags & WHITE_PHANTOM_KINGS_QUEENSIDE)
+		phantoms[SIDE_WHITE] = WHITE_PHANTOM_QUEENSIDE;
+
+	if (castle_flags & BLACK_PHANTOM_KINGS_KINGSIDE)
+		phantoms[SIDE_BLACK] = BLACK_PHANTOM_KINGSIDE;
+	else if (castle_flags & BLACK_PHANTOM_KINGS_QUEENSIDE)
+		phantoms[SIDE_BLACK] = BLACK_PHANTOM_QUEENSIDE;
+
+	for (piece = 0; piece < NR_PIECES; piece++) {
+		bitboard_t bitboard = pieces[piece];
+
+		/* Phantom kings are not real pieces. */
+		if ((piece & PIECE_MASK) == KING)
+			bitboard &= ~phantoms[piece & 1];
+
+		while (bitboard) {
+			add_piece(board, BIT_FIRST(bitboard), piece);
+			bitboard &= bitboard - 1;
+		}
+	}
+
+	board->bitboard[WHITE_KING] |= phantoms[SIDE_WHITE];
+	board->bitboard[WHITE_ALL] |= phantoms[SIDE_WHITE];
+	board->bitboard[BLACK_KING] |= phantoms[SIDE_BLACK];
+	board->bitboard[BLACK_ALL] |= phantoms[SIDE_BLACK];
+
+	board->current_player = current_player;
+	board->castle_flags = castle_flags;
+	board->en_passant = 0;
+	board->fifty_moves = 0;
+	board->hash_key = hash_key(board);
+}
+
 int setup_board_fen(board_t *board, char *fen) {
 	int i = 0;
 	int square = 56;
@@ -243,13 +446,57 @@ int setup_board_fen(board_t *board, char *fen) {
 
 	/* FIXME Implement move counter, legality check */
 
+	board->hash_key = hash_key(board);
+
 	return 0;
 }
 
+int bit_count(bitboard_t bitboard) {
+	int count = 0;
+
+	while (bitboard) {
+		bitboard &= bitboard - 1;
+		count++;
+	}
+
+	return count;
+}
+
+int bit_first(bitboard_t bitboard) {
+	int square = 0;
+
+	while (!(bitboard & 1)) {
+		bitboard >>= 1;
+		square++;
+	}
+
+	return square;
+}
+
+int bit_last(bitboard_t bitboard) {
+	int square = 63;
+
+	while (!(bitboard >> 63)) {
+		bitboard <<= 1;
+		square--;
+	}
+
+	return square;
+}
+
 void board_init(void) {
-	int i;
+	int i, j;
 	for (i = 0; i < 64; i++)
 		square_bit[i] = 1LL << i;
+
+	for (i = 0; i < NR_PIECES; i += 2)
+		for (j = 0; j < 64; j++) {
+			pst_mg[i][j] = pst_mg_white[i >> 1][j];
+			pst_eg[i][j] = pst_eg_white[i >> 1][j];
+			/* Mirror the tables vertically for black. */
+			pst_mg[i + 1][j ^ 56] = pst_mg_white[i >> 1][j];
+			pst_eg[i + 1][j ^ 56] = pst_eg_white[i >> 1][j];
+		}
 }
 
 void clear_board(board_t *board) {
@@ -262,6 +509,19 @@ void clear_board(board_t *board) {
 
 	board->material_value[SIDE_WHITE] = 0;
 	board->material_value[SIDE_BLACK] = 0;
+
+	board->pst_mg[SIDE_WHITE] = 0;
+	board->pst_mg[SIDE_BLACK] = 0;
+	board->pst_eg[SIDE_WHITE] = 0;
+	board->pst_eg[SIDE_BLACK] = 0;
+	board->phase = 0;
+
+	board->accumulator.dirty[SIDE_WHITE] = 1;
+	board->accumulator.dirty[SIDE_BLACK] = 1;
+
+	board->hash_key = 0;
+	board->pawn_hash_key = 0;
+	board->material_key = 0;
 }
 
 int find_black_piece(board_t *board, int square) {
@@ -21,6 +21,8 @@
 #ifndef DREAMER_BOARD_H
 #define DREAMER_BOARD_H
 
+#include "nnue.h"
+
 /* Chess pieces. Also used for indexing the bitboard array. */
 #define PAWN 0
 #define WHITE_PAWN 0
@@ -46,6 +48,27 @@
 
 #define SQUARE_BIT(A) (1LL << (A))
 
+/* Masks for ranks and files, counting from 0. */
+#define RANK_MASK(R) (0xffULL << ((R) << 3))
+#define FILE_MASK(F) (0x0101010101010101ULL << (F))
+
+/* Masks for the dark and light squares. */
+#define DARK_SQUARES 0xaa55aa55aa55aa55ULL
+#define LIGHT_SQUARES (~DARK_SQUARES)
+
+/* Number of squares set in a bitboard, and lowest and highest square set in a
+** non-empty bitboard.
+*/
+#ifdef __GNUC__
+#define BIT_COUNT(B) __builtin_popcountll(B)
+#define BIT_FIRST(B) __builtin_ctzll(B)
+#define BIT_LAST(B) (63 - __builtin_clzll(B))
+#else
+#define BIT_COUNT(B) bit_count(B)
+#define BIT_FIRST(B) bit_first(B)
+#define BIT_LAST(B) bit_last(B)
+#endif
+
 /* Empty squares required for kingside castle. */
 #define WHITE_EMPTY_KINGSIDE (SQUARE_BIT(SQUARE_F1) | SQUARE_BIT(SQUARE_G1))
 #define BLACK_EMPTY_KINGSIDE (SQUARE_BIT(SQUARE_F8) | SQUARE_BIT(SQUARE_G8))
@@ -160,9 +183,17 @@
 #define SQUARE_G8 62
 #define SQUARE_H8 63
 
+/* Game phase of the starting position. */
+#define PHASE_MAX 24
+
 /* Total number of types of pieces. */
 #define NR_PIECES 12
 
+/* The material key holds the number of pieces of each kind in four bits
+** per piece. MATERIAL_KEY_UNIT(P) is the key of a single piece P.
+*/
+#define MATERIAL_KEY_UNIT(P) (1LL << ((P) << 2))
+
 /* Total number of bitboards. */
 #define NR_BITBOARDS 14
 
@@ -179,6 +210,12 @@ typedef struct board {
 	/* Hash key of the current board. */
 	long long hash_key;
 
+	/* Hash key of the pawns on the current board. */
+	long long pawn_hash_key;
+
+	/* Material key of the current board, see MATERIAL_KEY_UNIT(). */
+	long long material_key;
+
 	/* 0-3 can_castle flags
 	** 4-5 has_castled flags
 	** 6-9 phantom kings flags
@@ -197,8 +234,22 @@ typedef struct board {
 	/* Number of pawns on the board for both black and white. */
 	int num_pawns[2];
 
+	/* Current total middlegame and endgame piece-square values for both
+	** black and white.
+	*/
+	int pst_mg[2];
+	int pst_eg[2];
+
+	/* Game phase, from 0 (pawns and kings only) to PHASE_MAX (all pieces on
+	** the board). Can exceed PHASE_MAX after promotions.
+	*/
+	int phase;
+
 	/* 50-move counter. */
 	int fifty_moves;
+
+	/* Network inputs, only kept up to date while nnue_enabled is set. */
+	nnue_accumulator_t accumulator;
 } board_t;
 
 typedef int move_t;
@@ -247,8 +298,26 @@ int find_white_piece(board_t *board, int square);
 **                 of the rook.
 */
 
+int bit_count(bitboard_t bitboard);
+/* Counts the squares set in a bitboard. Use BIT_COUNT instead.
+** Parameters: (bitboard_t) bitboard: The bitboard.
+** Returns   : (int): The number of squares set.
+*/
+
+int bit_first(bitboard_t bitboard);
+/* Finds the lowest square set in a bitboard. Use BIT_FIRST instead.
+** Parameters: (bitboard_t) bitboard: The bitboard, must not be empty.
+** Returns   : (int): The lowest square set.
+*/
+
+int bit_last(bitboard_t bitboard);
+/* Finds the highest square set in a bitboard. Use BIT_LAST instead.
+** Parameters: (bitboard_t) bitboard: The bitboard, must not be empty.
+** Returns   : (int): The highest square set.
+*/
+
 void board_init(void);
-/* Initialises the global array square_bit.
+/* Initialises the global array square_bit and the piece-square tables.
 ** Parameters: (void)
 ** Returns   : (void)
 */
@@ -265,6 +334,46 @@ void setup_board(board_t *board);
 ** Returns   : (void)
 */
 
+void board_set_piece_value(int piece, int value);
+/* Changes the material value of a piece type for both sides. Boards that
+** are already set up keep their old material totals.
+** Parameters: (int) piece: The piece type.
+**             (int) value: The new value.
+** Returns   : (void)
+*/
+
+int board_piece_value(int piece);
+/* Retrieves the material value of a piece, as counted in material_value.
+** Parameters: (int) piece: The piece.
+** Returns   : (int): The value.
+*/
+
+int board_piece_phase(int piece);
+/* Retrieves the contribution of a piece to the game phase.
+** Parameters: (int) piece: The piece.
+** Returns   : (int): The contribution.
+*/
+
+void board_piece_square_totals(const bitboard_t *pieces, int *mg, int *eg);
+/* Sums the piece-square values of a set of pieces, as kept in pst_mg and
+** pst_eg by a board with these pieces.
+** Parameters: (const bitboard_t *) pieces: The bitboards of the pieces,
+**                 indexed by piece, without phantom kings.
+**             (int *) mg: Receives the middlegame totals, indexed by side.
+**             (int *) eg: Receives the endgame totals, indexed by side.
+** Returns   : (void)
+*/
+
+void setup_board_bitboards(board_t *board, const bitboard_t *pieces, int current_player, int castle_flags);
+/* Sets up a board from the bitboards of its pieces.
+** Parameters: (board_t *) board: Pointer to the board to set up.
+**             (const bitboard_t *) pieces: The bitboards of the pieces,
+**                 indexed by piece.
+**             (int) current_player: The side to move.
+**             (int) castle_flags: The castling flags.
+** Returns   : (void)
+*/
+
 void execute_move(board_t *board, move_t move);
 /* Makes a move on a board.
 ** Parameters: (board_t *) board: Board to make the move on.
@@ -26,9 +26,11 @@
 #include "commands.h"
 #include "dreamer.h"
 #include "e_comm.h"
+#include "eval.h"
 #include "git_rev.h"
 #include "history.h"
 #include "move.h"
+#include "nnue.h"
 #include "repetition.h"
 #include "san.h"
 #include "search.h"
@@ -392,7 +394,8 @@ static int parse_time_control(state_t *state, char *s) {
 			return 1;
 	}
 
-	t.inc = strtol(end + 1, &end, 10) * 100;
+	/* Increments can be fractional. */
+	t.inc = (int)(strtod(end + 1, &end) * 100 + 0.5);
 
 	if (errno || *end != 0)
 		return 1;
@@ -432,6 +435,31 @@ static int command_always(state_t *state, char *command) {
 	if (!strncmp(command, "otim ", 5))
 		return 1;
 
+	if (!strcmp(command, "stats")) {
+		print_search_stats();
+		return 1;
+	}
+
+	if (!strncmp(command, "option SearchStats=", 19)) {
+		if (!strcmp(command + 19, "0") || !strcmp(command + 19, "1"))
+			set_option(OPTION_STATS, command[19] == '1');
+		else
+			BADPARAM(command);
+		return 1;
+	}
+
+	if (!strncmp(command, "option MultiPV=", 15)) {
+		long val;
+		char *end;
+		errno = 0;
+		val = strtol(command + 15, &end, 10);
+		if (errno || *end != 0 || val < 1 || val > MULTI_PV_MAX)
+			BADPARAM(command);
+		else
+			state->multi_pv = val;
+		return 1;
+	}
+
 	return 0;
 }
 
@@ -511,6 +539,11 @@ void command_handle(state_t *state, char *command) {
 		e_comm_send("feature myname=\"Dreamer %s\"\n", g_version);
 		e_comm_send("feature setboard=1\n");
 		e_comm_send("feature colors=0\n");
+		e_comm_send("feature option=\"MultiPV -spin 1 1 %i\"\n", MULTI_PV_MAX);
+		e_comm_send("feature option=\"SearchStats -check 0\"\n");
+		if (nnue_loaded())
+			e_comm_send("feature option=\"Evaluation -combo %sNetwork /// %sClassic\"\n", (nnue_enabled ? "*" : ""),
+						(nnue_enabled ? "" : "*"));
 		e_comm_send("feature done=1\n");
 		return;
 	}
@@ -524,13 +557,31 @@ void command_handle(state_t *state, char *command) {
 
 	if (!strncmp(command, "accepted ", 9)) {
 		if (!strcmp(command + 9, "setboard") || !strcmp(command + 9, "done") || !strcmp(command + 9, "myname") ||
-			!strcmp(command + 9, "colors"))
+			!strcmp(command + 9, "colors") || !strcmp(command + 9, "option"))
 			return;
 
 		BADPARAM(command);
 		return;
 	}
 
+	if (!strncmp(command, "option Evaluation=", 18)) {
+		int network = !strcmp(command + 18, "Network");
+
+		if ((!network && strcmp(command + 18, "Classic")) || nnue_enable(network)) {
+			BADPARAM(command);
+			return;
+		}
+
+		/* The accumulators are not updated while the network is off, and
+		** cached scores came from the other evaluation.
+		*/
+		state->board.accumulator.dirty[SIDE_WHITE] = 1;
+		state->board.accumulator.dirty[SIDE_BLACK] = 1;
+		eval_clear_caches();
+		clear_table();
+		return;
+	}
+
 	if (!strcmp(command, "new")) {
 		setup_board(&state->board);
 		forget_history();
@@ -542,10 +593,7 @@ void command_handle(state_t *state, char *command) {
 		state->flags = 0;
 		state->depth = MAX_DEPTH;
 
-		if (state->undo_data != NULL)
-			free(state->undo_data);
-		state->undo_data = NULL;
-
+		/* The undo buffer is kept for the next game. */
 		state->moves = 0;
 		timer_init(&state->engine_time, 1);
 		timer_set(&state->engine_time, state->time.base * 60 * 100);
@@ -554,7 +602,6 @@ void command_handle(state_t *state, char *command) {
 		state->hint = NO_MOVE;
 		state->ponder_opp_move = NO_MOVE;
 		state->ponder_my_move = NO_MOVE;
-		state->ponder_actual_move = NO_MOVE;
 		return;
 	}
 
@@ -688,6 +735,7 @@ void command_handle(state_t *state, char *command) {
 
 	if (!strcmp(command, "easy")) {
 		set_option(OPTION_PONDER, 0);
+		state->flags &= ~FLAG_PONDER;
 		state->ponder_my_move = NO_MOVE;
 		return;
 	}
@@ -713,70 +761,3 @@ void command_handle(state_t *state, char *command) {
 
 	UNKNOWN(command);
 }
-
-int command_check_abort(state_t *state, int ply, char *command) {
-	if (!strcmp(command, "?")) {
-		if (my_turn(state))
-			return 1;
-	}
-
-	if (command_always(state, command))
-		return 0;
-
-	if (!strcmp(command, "new")) {
-		state->flags = FLAG_NEW_GAME | FLAG_IGNORE_MOVE;
-		return 1;
-	}
-
-	if (!strcmp(command, "quit") || !strcmp(command, "force")) {
-		state->flags = FLAG_IGNORE_MOVE;
-		command_handle(state, command);
-		return 1;
-	}
-
-	if (!strcmp(command, "easy")) {
-		if (state->flags & FLAG_PONDER) {
-			state->flags = FLAG_IGNORE_MOVE;
-			state->ponder_actual_move = NO_MOVE;
-		}
-		command_handle(state, command);
-		return 1;
-	}
-
-	if (!strcmp(command, "hint")) {
-		if (state->flags & FLAG_PONDER) {
-			char *str = coord_move_str(state->ponder_opp_move);
-			e_comm_send("Hint: %s\n", str);
-			free(str);
-			return 0;
-		}
-	}
-
-	if (state->flags & FLAG_PONDER) {
-		move_t move;
-
-		if (!parse_move(&state->root_board, ply, command, &move)) {
-			if (move == NO_MOVE) {
-				e_comm_send("Illegal move: %s\n", command);
-				return 0;
-			}
-
-			/* Start our timer */
-			timer_start(&state->engine_time);
-
-			if (move == state->ponder_opp_move) {
-				/* User made the expected move. */
-				state->flags = 0;
-				return 0;
-			} else {
-				/* User made a different move, abort and restart search. */
-				state->flags = FLAG_IGNORE_MOVE;
-				state->ponder_actual_move = move;
-				return 1;
-			}
-		}
-	}
-
-	NOT_NOW(command);
-	return 0;
-}
@@ -18,8 +18,10 @@
 **  along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "board.h"
 #include "commands.h"
@@ -30,37 +32,43 @@
 #include "move.h"
 #include "repetition.h"
 #include "search.h"
+#include "thread.h"
 #include "transposition.h"
 
-#ifdef _WIN32
-
-#include <windows.h>
-#define drm_sleep(M) Sleep(M)
-
-#elif defined HAVE_USLEEP
-
-#include <unistd.h>
-
-#define drm_sleep(M) usleep((M)*1000)
+static timer start_time;
+static state_t state;
 
-#else
+/* Time limits of the current move in milliseconds. The search is aborted
+** at the hard limit. No new iteration is started once the soft limit,
+** scaled by time_scale percent, has passed.
+*/
+static int soft_limit;
+static int hard_limit;
+static int time_scale;
+static int move_overhead = 30;
 
-#include <sys/time.h>
-#include <sys/types.h>
-#include <unistd.h>
+/* Best move and score of the last iteration, and for how many iterations
+** the best move has stayed the same.
+*/
+static move_t last_best_move;
+static int last_score;
+static int stable_iterations;
 
-static void drm_sleep(unsigned long usec) {
-	struct timeval tv;
+/* Set while pondering when the time limits would have stopped the search. */
+static int ponder_stop;
 
-	tv.tv_sec = 0;
-	tv.tv_usec = usec;
-	select(0, 0, 0, 0, &tv);
-}
+int search_interrupts;
 
-#endif
+/* Clock time in centiseconds that came with INTERRUPT_CLOCK. */
+static int interrupt_clock;
 
-static int start_time;
-static state_t state;
+/* What the running search is doing, for the input thread: SEARCH_THINKING
+** or SEARCH_PONDERING. While pondering, the board before the expected move
+** and the move itself. Only used while the filter is set.
+*/
+static int search_kind;
+static board_t search_board;
+static move_t search_ponder_move;
 
 int my_turn(state_t *state) {
 	return (((state->mode == MODE_WHITE) && (state->board.current_player == SIDE_WHITE)) ||
@@ -147,27 +155,147 @@ void check_game_end(state_t *state) {
 	}
 }
 
-int check_abort(int ply) {
-	char *s;
+static int search_filter(char *command) {
+	/* Decides on the input thread what a command means for the running
+	** search. Returns non-zero if the engine still has to handle the
+	** command after the search.
+	*/
+	move_t move;
+
+	if (!strncmp(command, "time ", 5)) {
+		char *end;
+		long time;
 
-	if (!(state.flags & FLAG_PONDER) && (timer_get(&state.move_time) <= 0))
+		errno = 0;
+		time = strtol(command + 5, &end, 10);
+		if (errno || *end != 0)
+			return 1;
+
+		ATOMIC_SET(&interrupt_clock, (int)time);
+		ATOMIC_OR(&search_interrupts, INTERRUPT_CLOCK);
+		return 0;
+	}
+
+	if (!strncmp(command, "otim ", 5))
+		return 0;
+
+	if (!strcmp(command, "new") || !strcmp(command, "quit") || !strcmp(command, "force")) {
+		ATOMIC_OR(&search_interrupts, INTERRUPT_ABORT);
 		return 1;
+	}
+
+	if (search_kind == SEARCH_THINKING) {
+		if (!strcmp(command, "?")) {
+			ATOMIC_OR(&search_interrupts, INTERRUPT_STOP);
+			return 0;
+		}
 
-	s = e_comm_poll();
-	if (!s)
+		if (!strcmp(command, "easy"))
+			ATOMIC_OR(&search_interrupts, INTERRUPT_STOP);
+
+		/* Anything else waits until the move has been made. */
+		return 1;
+	}
+
+	if (!strcmp(command, "hint")) {
+		ATOMIC_OR(&search_interrupts, INTERRUPT_HINT);
+		return 0;
+	}
+
+	if (!parse_move(&search_board, 0, command, &move) && move == search_ponder_move) {
+		/* The pondering goes on as the real search. */
+		search_kind = SEARCH_THINKING;
+		ATOMIC_OR(&search_interrupts, INTERRUPT_PONDERHIT);
 		return 0;
-	return command_check_abort(&state, ply, s);
+	}
+
+	/* Other moves and commands are handled once pondering has stopped, and
+	** pondering starts again afterwards if needed.
+	*/
+	ATOMIC_OR(&search_interrupts, INTERRUPT_ABORT);
+	return 1;
+}
+
+static int handle_interrupts(int interrupts) {
+	/* Acts on interrupts from the input thread. Returns non-zero if the
+	** search must stop.
+	*/
+	if (interrupts & INTERRUPT_CLOCK)
+		timer_set(&state.engine_time, ATOMIC_GET(&interrupt_clock));
+
+	if (interrupts & INTERRUPT_HINT) {
+		char *str = coord_move_str(state.ponder_opp_move);
+		e_comm_send("Hint: %s\n", str);
+		free(str);
+	}
+
+	if (interrupts & INTERRUPT_PONDERHIT) {
+		/* Start our timer */
+		timer_start(&state.engine_time);
+
+		/* User made the expected move, the search continues on our own
+		** clock.
+		*/
+		state.flags = 0;
+		ponder_hit();
+	}
+
+	if (interrupts & INTERRUPT_ABORT) {
+		state.flags = FLAG_IGNORE_MOVE;
+		return 1;
+	}
+
+	return (interrupts & INTERRUPT_STOP) != 0;
+}
+
+int begin_search(int kind) {
+	search_kind = kind;
+	search_board = state.root_board;
+	search_ponder_move = state.ponder_opp_move;
+	ATOMIC_SET(&search_interrupts, 0);
+
+	/* Commands that arrived before the search are handled first. */
+	return e_comm_set_filter(search_filter);
+}
+
+void end_search(void) {
+	int interrupts;
+
+	e_comm_set_filter(NULL);
+
+	/* The search has ended, so stopping it no longer matters, and the
+	** commands that stop it are still in the queue.
+	*/
+	interrupts = ATOMIC_EXCHANGE(&search_interrupts, 0);
+	handle_interrupts(interrupts & ~(INTERRUPT_STOP | INTERRUPT_ABORT));
+}
+
+int check_abort(void) {
+	int interrupts = ATOMIC_EXCHANGE(&search_interrupts, 0);
+
+	if (interrupts && handle_interrupts(interrupts))
+		return 1;
+
+	if (!(state.flags & FLAG_PONDER) && (timer_get_ms(&state.move_time) <= 0))
+		return 1;
+
+	return 0;
 }
 
 void do_move(state_t *state, move_t move) {
 	state->moves++;
-	state->undo_data = realloc(state->undo_data, sizeof(undo_data_t) * state->moves);
+
+	if (state->moves > state->undo_size) {
+		state->undo_size = state->undo_size ? state->undo_size * 2 : 256;
+		state->undo_data = realloc(state->undo_data, sizeof(undo_data_t) * state->undo_size);
+	}
+
 	state->undo_data[state->moves - 1].en_passant = state->board.en_passant;
 	state->undo_data[state->moves - 1].castle_flags = state->board.castle_flags;
 	state->undo_data[state->moves - 1].fifty_moves = state->board.fifty_moves;
 	state->undo_data[state->moves - 1].move = move;
 	execute_move(&state->board, move);
-	repetition_add(&state->board, move);
+	repetition_add(&state->board);
 }
 
 void undo_move(state_t *state) {
@@ -183,37 +311,110 @@ void undo_move(state_t *state) {
 }
 
 static void set_start_time(void) {
-	struct timeval tv;
+	timer_init(&start_time, 0);
+	timer_start(&start_time);
+}
+
+void set_move_overhead(int ms) {
+	move_overhead = ms;
+}
+
+static void set_time_limits(void) {
+	int remaining = timer_get_ms(&state.engine_time) - move_overhead;
+	int moves_left = 30;
+	int target;
+
+	timer_init(&state.move_time, 1);
+
+	if (remaining <= 0) {
+		soft_limit = hard_limit = 0;
+		timer_set_ms(&state.move_time, 0);
+		return;
+	}
+
+	if (state.time.mps != 0)
+		moves_left = state.time.mps - (state.moves / 2) % state.time.mps;
+
+	target = remaining / moves_left + state.time.inc * 10;
+
+	/* Never use more than 80% of the clock on one move. */
+	hard_limit = target * 3;
+	if (hard_limit > remaining * 8 / 10)
+		hard_limit = remaining * 8 / 10;
 
-	gettimeofday(&tv, NULL);
+	soft_limit = target * 6 / 10;
+	if (soft_limit > hard_limit)
+		soft_limit = hard_limit;
 
-	start_time = tv.tv_sec;
+	timer_set_ms(&state.move_time, hard_limit);
 }
 
 void set_move_time(void) {
-	int safe_time = timer_get(&state.engine_time) - 1000;
+	last_best_move = NO_MOVE;
+	last_score = 0;
+	stable_iterations = 0;
+	time_scale = 100;
+	ponder_stop = 0;
 
-	timer_init(&state.move_time, 1);
+	set_time_limits();
+}
 
-	if (safe_time > 0) {
-		if (state.time.mps == 0)
-			timer_set(&state.move_time, safe_time / 30 + state.time.inc);
-		else {
-			int moves_left = state.time.mps - (state.moves / 2) % state.time.mps;
-			timer_set(&state.move_time, safe_time / moves_left + state.time.inc);
-		}
-	} else
-		timer_set(&state.move_time, 0);
+void ponder_hit(void) {
+	/* The ponder search goes on as the real search. Its time budget is
+	** that of a normal move, counted from now, and the stability of its
+	** best move so far still counts. The other replies are no longer
+	** pondered on.
+	*/
+	stop_ponder_helpers();
+	set_time_limits();
+
+	/* The ponder search has already run longer than a normal search would
+	** have, so its best move is played at once.
+	*/
+	if (ponder_stop)
+		timer_set_ms(&state.move_time, 0);
+
+	timer_start(&state.move_time);
 }
 
-int get_time(void) {
-	struct timeval tv;
+int check_stop(move_t best_move, int score) {
+	int fail_low = last_best_move != NO_MOVE && score < last_score - 30;
+	int changed = last_best_move != NO_MOVE && best_move != last_best_move;
+	int stop;
+
+	if (changed)
+		stable_iterations = 0;
+	else
+		stable_iterations++;
+
+	/* Spend more time when the best move changes or the score drops, and
+	** less when the best move has been stable for several iterations.
+	*/
+	time_scale = 100;
 
-	gettimeofday(&tv, NULL);
+	if (changed)
+		time_scale += 60;
 
-	tv.tv_sec -= start_time;
+	if (fail_low)
+		time_scale += 60;
+	else if (stable_iterations >= 4)
+		time_scale = 60;
 
-	return tv.tv_sec * 100 + tv.tv_usec / 10000;
+	last_best_move = best_move;
+	last_score = score;
+
+	stop = hard_limit - timer_get_ms(&state.move_time) >= soft_limit * time_scale / 100;
+
+	if (state.flags & FLAG_PONDER) {
+		ponder_stop = stop;
+		return 0;
+	}
+
+	return stop;
+}
+
+int get_time(void) {
+	return timer_get(&start_time);
 }
 
 static void update_clock(state_t *state) {
@@ -242,16 +443,32 @@ void send_move(state_t *state, move_t move) {
 	check_game_end(state);
 }
 
+static int is_searching(state_t *state) {
+	/* Whether the main loop has a move to think or ponder on. */
+	if (state->mode == MODE_IDLE || state->mode == MODE_FORCE || state->mode == MODE_QUIT || state->done)
+		return 0;
+
+	return my_turn(state) || (state->flags & FLAG_PONDER);
+}
+
 int engine(void *data) {
+	if (search_thread_init()) {
+		fprintf(stderr, "Failed to allocate memory for search tables\n");
+		transposition_exit();
+		return 1;
+	}
+
 	e_comm_init();
 	set_start_time();
 
 	state.time.mps = 40;
 	state.time.base = 5;
 	state.time.inc = 0;
+	state.multi_pv = 1;
 	set_option(OPTION_QUIESCE, 1);
 	set_option(OPTION_PONDER, 0);
 	set_option(OPTION_POST, 0);
+	set_option(OPTION_STATS, 0);
 
 	command_handle(&state, "new");
 
@@ -259,26 +476,30 @@ int engine(void *data) {
 		char *s;
 		move_t move;
 
-		s = e_comm_poll();
+		/* Sleep until a command arrives, unless there is a move to search. */
+		if (is_searching(&state))
+			s = e_comm_poll();
+		else
+			s = e_comm_wait();
 
-		if (!s)
-			drm_sleep(10);
-		else {
+		if (s) {
 			command_handle(&state, s);
 			free(s);
 		}
 
-		if (state.mode != MODE_IDLE && state.mode != MODE_FORCE && !state.done) {
+		if (is_searching(&state)) {
 			if (my_turn(&state)) {
+				if (begin_search(SEARCH_THINKING))
+					continue;
+
 				state.flags = 0;
 				set_move_time();
 
 				timer_start(&state.engine_time);
 				move = find_best_move(&state);
+				end_search();
 
-				if (state.flags & FLAG_NEW_GAME)
-					command_handle(&state, "new");
-				else if (MOVE_IS_REGULAR(move)) {
+				if (MOVE_IS_REGULAR(move)) {
 					send_move(&state, move);
 					timer_stop(&state.engine_time);
 					if (get_option(OPTION_PONDER))
@@ -287,16 +508,16 @@ int engine(void *data) {
 			} else if (state.flags & FLAG_PONDER) {
 				move = ponder(&state);
 
-				if (state.flags & FLAG_NEW_GAME)
-					command_handle(&state, "new");
-				else if (!my_turn(&state)) {
+				if (!my_turn(&state)) {
 					if (move != NO_MOVE) {
 						/* We are done pondering, but opponent hasn't moved yet. */
 						state.ponder_my_move = move;
 						state.flags = 0;
 					} else {
-						/* Opponent made an illegal move, continue pondering. */
-						if (get_option(OPTION_PONDER))
+						/* Pondering was interrupted by a command, continue
+						** pondering once it has been handled.
+						*/
+						if (get_option(OPTION_PONDER) && state.hint != NO_MOVE)
 							state.flags |= FLAG_PONDER;
 					}
 				} else if (MOVE_IS_REGULAR(move)) {
@@ -309,6 +530,8 @@ int engine(void *data) {
 		}
 	}
 
+	e_comm_exit();
+	search_thread_exit();
 	transposition_exit();
 	return 0;
 }
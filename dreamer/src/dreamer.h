@@ -31,12 +31,28 @@
 #define MODE_QUIT 4
 
 #define FLAG_IGNORE_MOVE (1 << 0)
-#define FLAG_NEW_GAME (1 << 1)
 #define FLAG_PONDER (1 << 2)
-#define FLAG_DELAY_MOVE (1 << 2)
+
+#define SEARCH_THINKING 0
+#define SEARCH_PONDERING 1
+
+/* Interrupts of a search, set by the input thread in search_interrupts. */
+/* Stop and make the best move so far. */
+#define INTERRUPT_STOP (1 << 0)
+/* Stop and ignore the result, for a command that is still queued. */
+#define INTERRUPT_ABORT (1 << 1)
+/* The opponent made the move that is pondered on. */
+#define INTERRUPT_PONDERHIT (1 << 2)
+/* The ui sent the time left on our clock. */
+#define INTERRUPT_CLOCK (1 << 3)
+/* The ui asked for a hint while pondering. */
+#define INTERRUPT_HINT (1 << 4)
 
 #define MAX_DEPTH 30
 
+/* Maximum number of best moves that are reported at each depth. */
+#define MULTI_PV_MAX 64
+
 typedef struct {
 	bitboard_t en_passant;
 	int castle_flags;
@@ -55,9 +71,12 @@ typedef struct state {
 	int mode;
 	int flags;
 	int depth;
+	/* Number of best moves that are reported at each depth. */
+	int multi_pv;
 	board_t board;
 	board_t root_board;
 	undo_data_t *undo_data;
+	int undo_size;
 	int moves;
 	int options;
 	struct time_control time;
@@ -66,11 +85,13 @@ typedef struct state {
 	move_t hint;
 	move_t ponder_opp_move;
 	move_t ponder_my_move;
-	move_t ponder_actual_move;
 } state_t;
 
 int my_turn(state_t *state);
 
+/* INTERRUPT_* flags for the running search, checked at every node. */
+extern int search_interrupts;
+
 #define STATE_NORMAL 0
 #define STATE_CHECK 1
 #define STATE_MATE 2
@@ -79,18 +100,24 @@ int my_turn(state_t *state);
 #define OPTION_QUIESCE 0
 #define OPTION_POST 1
 #define OPTION_PONDER 2
+#define OPTION_STATS 3
 
 int engine(void *data);
 int check_game_state(board_t *board, int ply);
 void check_game_end(state_t *state);
 void do_move(state_t *state, move_t move);
 void undo_move(state_t *state);
-int check_abort(int ply);
+int check_abort(void);
+int begin_search(int kind);
+void end_search(void);
+int check_stop(move_t best_move, int score);
+void set_move_overhead(int ms);
 int get_option(int option);
 void set_option(int option, int value);
 int get_time(void);
 int is_check(board_t *board, int ply);
 void send_move(state_t *state, move_t move);
 void set_move_time(void);
+void ponder_hit(void);
 
 #endif
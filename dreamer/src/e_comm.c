@@ -21,8 +21,156 @@
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "e_comm.h"
+#include "thread.h"
+
+/* Messages received by the input thread, oldest first. */
+typedef struct message {
+	char *text;
+	struct message *next;
+} message_t;
+
+static message_t *queue_head;
+static message_t *queue_tail;
+static mutex_t *queue_mutex;
+static cond_t *queue_cond;
+static thread_t *input;
+
+/* Number of messages in the queue. */
+static int queue_length;
+
+/* Function that sees each message before it is queued. */
+static int (*queue_filter)(char *message);
+
+static void queue_push(char *text) {
+	message_t *message;
+
+	mutex_lock(queue_mutex);
+
+	if (queue_filter && !queue_filter(text)) {
+		mutex_unlock(queue_mutex);
+		free(text);
+		return;
+	}
+
+	message = malloc(sizeof(message_t));
+	message->text = text;
+	message->next = NULL;
+
+	if (queue_tail)
+		queue_tail->next = message;
+	else
+		queue_head = message;
+
+	queue_tail = message;
+	ATOMIC_SET(&queue_length, queue_length + 1);
+
+	cond_signal(queue_cond);
+	mutex_unlock(queue_mutex);
+}
+
+static int input_thread(void *data) {
+	/* Reads messages from standard input, so that the engine only checks
+	** a flag while it is searching.
+	*/
+	while (1) {
+		char *text = e_comm_read();
+		int quit;
+
+		/* The ui went away, quit once the queue is handled. */
+		if (!text)
+			text = strdup("quit");
+
+		quit = !strcmp(text, "quit");
+		queue_push(text);
+
+		/* Nothing is read after quit, so that the engine can wait for
+		** this thread.
+		*/
+		if (quit)
+			return 0;
+	}
+}
+
+void e_comm_init(void) {
+	e_comm_open();
+
+	queue_mutex = mutex_create();
+	queue_cond = cond_create();
+
+	if (!queue_mutex || !queue_cond || !(input = thread_create(input_thread, NULL))) {
+		fprintf(stderr, "Error: could not start input thread.\n");
+		exit(1);
+	}
+}
+
+static char *queue_pop(void) {
+	/* Takes the oldest message. The queue must be locked and not empty. */
+	message_t *message = queue_head;
+	char *text = message->text;
+
+	queue_head = message->next;
+	if (!queue_head)
+		queue_tail = NULL;
+	ATOMIC_SET(&queue_length, queue_length - 1);
+
+	free(message);
+	return text;
+}
+
+void e_comm_exit(void) {
+	thread_join(input);
+
+	while (queue_head)
+		free(queue_pop());
+
+	cond_destroy(queue_cond);
+	mutex_destroy(queue_mutex);
+	e_comm_close();
+}
+
+char *e_comm_poll(void) {
+	char *text;
+
+	if (!ATOMIC_GET(&queue_length))
+		return NULL;
+
+	mutex_lock(queue_mutex);
+	text = queue_pop();
+	mutex_unlock(queue_mutex);
+
+	return text;
+}
+
+char *e_comm_wait(void) {
+	char *text;
+
+	mutex_lock(queue_mutex);
+
+	while (!queue_head)
+		cond_wait(queue_cond, queue_mutex);
+
+	text = queue_pop();
+	mutex_unlock(queue_mutex);
+
+	return text;
+}
+
+int e_comm_set_filter(int (*filter)(char *message)) {
+	int retval = 0;
+
+	mutex_lock(queue_mutex);
+
+	if (filter && queue_head)
+		retval = -1;
+	else
+		queue_filter = filter;
+
+	mutex_unlock(queue_mutex);
+	return retval;
+}
 
 void e_comm_send(const char *fmt, ...) {
 	/* Code adapted from example in PRINTF(3) */
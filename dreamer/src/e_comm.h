@@ -28,7 +28,7 @@ void e_comm_init(void);
 */
 
 void e_comm_exit(void);
-/* Exits the I/O library cleanly.
+/* Exits the I/O library cleanly, once the input thread has received quit.
 ** Parameters: (void)
 ** Returns   : (void)
 */
@@ -46,11 +46,49 @@ void e_comm_send_str(const char *m);
 */
 
 char *e_comm_poll(void);
-/* Polls the I/O library for input from the xboard ui.
+/* Takes the oldest message that the input thread received from the xboard
+** ui.
 ** Parameters: (void)
 ** Returns   : (char *), Message that was received from the I/O library (if
 **                 any).
 **             NULL, otherwise.
 */
 
+char *e_comm_wait(void);
+/* Waits for a message from the xboard ui.
+** Parameters: (void)
+** Returns   : (char *), Message that was received from the I/O library.
+*/
+
+int e_comm_set_filter(int (*filter)(char *message));
+/* Sets a function that the input thread calls for each message before it
+** is queued, with the queue locked. A message is only queued if the
+** function returns non-zero.
+** Parameters: (int (*)(char *)) filter: The function, or NULL to queue
+**                 all messages.
+** Returns   : (int): 0 on success, -1 if messages are waiting, in which
+**                 case no function is set.
+*/
+
+/* Functions implemented by the platform layer. */
+
+void e_comm_open(void);
+/* Sets up standard input and output for communication.
+** Parameters: (void)
+** Returns   : (void)
+*/
+
+void e_comm_close(void);
+/* Cleans up standard input and output.
+** Parameters: (void)
+** Returns   : (void)
+*/
+
+char *e_comm_read(void);
+/* Waits for a message from the xboard ui. Only called by the input thread.
+** Parameters: (void)
+** Returns   : (char *), The message.
+**             NULL, if the input was closed.
+*/
+
 #endif
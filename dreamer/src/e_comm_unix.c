@@ -22,11 +22,12 @@
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <sys/select.h>
 
 #include "e_comm.h"
 #include "pipe_unix.h"
 
-void e_comm_init(void) {
+void e_comm_open(void) {
 	/* xboard ui's may send SIGINT to stop thinking or pondering.
 	** We don't need this signal, so we ignore it.
 	*/
@@ -36,7 +37,7 @@ void e_comm_init(void) {
 	pipe_unix_init(0, 1);
 }
 
-void e_comm_exit(void) {
+void e_comm_close(void) {
 	pipe_unix_exit();
 }
 
@@ -44,12 +45,21 @@ void e_comm_send_str(const char *str) {
 	pipe_unix_send(str);
 }
 
-char *e_comm_poll(void) {
-	int error;
-	char *retval = pipe_unix_poll(&error);
+char *e_comm_read(void) {
+	while (1) {
+		int error;
+		char *retval = pipe_unix_poll(&error);
+		fd_set in_set;
 
-	if (error)
-		exit(1);
+		if (error)
+			return NULL;
 
-	return retval;
+		if (retval)
+			return retval;
+
+		/* Sleep until more data arrives. */
+		FD_ZERO(&in_set);
+		FD_SET(0, &in_set);
+		select(1, &in_set, NULL, NULL, NULL);
+	}
 }
@@ -24,7 +24,7 @@
 #include "e_comm.h"
 #include "pipe_win32.h"
 
-void e_comm_init(void) {
+void e_comm_open(void) {
 	HANDLE h_in, h_out;
 	DWORD mode;
 
@@ -39,7 +39,7 @@ void e_comm_init(void) {
 	pipe_win32_init(h_in, h_out, GetConsoleMode(h_in, &mode) != 0);
 }
 
-void e_comm_exit(void) {
+void e_comm_close(void) {
 	pipe_win32_exit();
 }
 
@@ -47,12 +47,18 @@ void e_comm_send_str(const char *str) {
 	pipe_win32_send(str);
 }
 
-char *e_comm_poll(void) {
-	int error;
-	char *retval = pipe_win32_poll(&error);
+char *e_comm_read(void) {
+	while (1) {
+		int error;
+		char *retval = pipe_win32_poll(&error);
 
-	if (error)
-		exit(1);
+		if (error)
+			return NULL;
+
+		if (retval)
+			return retval;
 
-	return retval;
+		/* Pipes can't be waited on, so check again shortly. */
+		Sleep(1);
+	}
 }
@@ -0,0 +1,305 @@
+/*  DreamChess
+**
+**  DreamChess is the legal property of its developers, whose names are too
+**  numerous to list here. Please refer to the AUTHORS.txt file distributed
+**  with this source distribution.
+**
+**  This program is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+
+#include "board.h"
+#include "endgame.h"
+#include "kpk.h"
+
+/* Number of entries in the endgame table. Must be a power of two. */
+#define ENDGAME_ENTRIES 256
+
+/* Scale factor for endings that are usually drawn, like KRKN and KRKB. */
+#define ENDGAME_SCALE_DRAWISH 16
+
+typedef int (*endgame_func_t)(board_t *board, int strong);
+
+/* Specialised evaluation for one material signature. */
+typedef struct endgame {
+	long long material_key;
+	/* ENDGAME_DRAW, ENDGAME_EVAL, ENDGAME_EXACT or ENDGAME_SCALE, or
+	** ENDGAME_NONE for an empty entry.
+	*/
+	int type;
+	/* Side with the extra material. */
+	int strong;
+	/* Computes the score for the strong side for ENDGAME_EVAL and
+	** ENDGAME_EXACT, or the
+	** scale factor for ENDGAME_SCALE. When NULL, value is the scale factor.
+	*/
+	endgame_func_t func;
+	int value;
+} endgame_t;
+
+static endgame_t endgames[ENDGAME_ENTRIES];
+
+/* Highest game phase of any endgame in the table. */
+static int max_phase;
+
+static int distance(int square1, int square2) {
+	int rank_distance = abs((square1 >> 3) - (square2 >> 3));
+	int file_distance = abs((square1 & 7) - (square2 & 7));
+
+	return rank_distance > file_distance ? rank_distance : file_distance;
+}
+
+static int king_square(board_t *board, int side) {
+	/* Right after castling the king bitboard also holds phantom kings,
+	** which are on the squares between the king and its initial square.
+	*/
+	bitboard_t kings = board->bitboard[KING + side];
+
+	if (board->castle_flags & (side == SIDE_WHITE ? WHITE_PHANTOM_KINGS_KINGSIDE : BLACK_PHANTOM_KINGS_KINGSIDE))
+		return BIT_LAST(kings);
+
+	return BIT_FIRST(kings);
+}
+
+static int push_to_edge(int square) {
+	/* Number of steps between a square and the centre, from 0 to 6. */
+	int rank = square >> 3;
+	int file = square & 7;
+
+	return (rank < 4 ? 3 - rank : rank - 4) + (file < 4 ? 3 - file : file - 4);
+}
+
+static int eval_kxk(board_t *board, int strong) {
+	/* Mating material against a lone king. Drive the king to the edge and
+	** bring the own king closer.
+	*/
+	int weak = OPPONENT(strong);
+	int weak_king = king_square(board, weak);
+
+	return board->material_value[strong] - board->material_value[weak] + ENDGAME_KNOWN_WIN +
+		   push_to_edge(weak_king) * 10 + (7 - distance(king_square(board, strong), weak_king)) * 10;
+}
+
+static int eval_kbbk(board_t *board, int strong) {
+	bitboard_t bishops = board->bitboard[BISHOP + strong];
+
+	/* Bishops on squares of one colour can't mate. */
+	if (!(bishops & DARK_SQUARES) || !(bishops & LIGHT_SQUARES))
+		return 0;
+
+	return eval_kxk(board, strong);
+}
+
+static int eval_kbnk(board_t *board, int strong) {
+	/* Mate can only be forced in a corner of the colour of the bishop. */
+	int weak = OPPONENT(strong);
+	int weak_king = king_square(board, weak);
+	int corner_distance;
+
+	if (board->bitboard[BISHOP + strong] & DARK_SQUARES) {
+		int a1 = distance(weak_king, SQUARE_A1);
+		int h8 = distance(weak_king, SQUARE_H8);
+
+		corner_distance = a1 < h8 ? a1 : h8;
+	} else {
+		int a8 = distance(weak_king, SQUARE_A8);
+		int h1 = distance(weak_king, SQUARE_H1);
+
+		corner_distance = a8 < h1 ? a8 : h1;
+	}
+
+	return board->material_value[strong] - board->material_value[weak] + ENDGAME_KNOWN_WIN +
+		   (7 - corner_distance) * 20 + (7 - distance(king_square(board, strong), weak_king)) * 10;
+}
+
+static int eval_kpk(board_t *board, int strong) {
+	/* Exact result from the bitbase, plus a bonus for advancing the pawn
+	** to make progress in won positions.
+	*/
+	int weak = OPPONENT(strong);
+	int strong_king = king_square(board, strong);
+	int weak_king = king_square(board, weak);
+	int pawn = BIT_FIRST(board->bitboard[PAWN + strong]);
+	int side = board->current_player;
+
+	/* The bitbase has the pawn on the white side. */
+	if (strong == SIDE_BLACK) {
+		strong_king ^= 56;
+		weak_king ^= 56;
+		pawn ^= 56;
+		side = OPPONENT(side);
+	}
+
+	if (!kpk_probe(strong_king, pawn, weak_king, side))
+		return 0;
+
+	return board->material_value[strong] - board->material_value[weak] + ENDGAME_KNOWN_WIN + (pawn >> 3) * 10;
+}
+
+static int scale_kbpk(board_t *board, int strong) {
+	/* Rook pawns with a bishop that doesn't control the promotion square
+	** only draw when the defending king reaches the corner.
+	*/
+	bitboard_t pawns = board->bitboard[PAWN + strong];
+	int queening;
+
+	if (!(pawns & ~FILE_MASK(0)))
+		queening = 0;
+	else if (!(pawns & ~FILE_MASK(7)))
+		queening = 7;
+	else
+		return ENDGAME_SCALE_NORMAL;
+
+	if (strong == SIDE_WHITE)
+		queening += SQUARE_A8;
+
+	if (!(board->bitboard[BISHOP + strong] & DARK_SQUARES) == !(square_bit[queening] & DARK_SQUARES))
+		return ENDGAME_SCALE_NORMAL;
+
+	if (distance(king_square(board, OPPONENT(strong)), queening) <= 1)
+		return 0;
+
+	return ENDGAME_SCALE_NORMAL;
+}
+
+static long long signature_key(const char *pieces, int side, int *phase) {
+	/* Computes the material key of a string of pieces like "KBN". */
+	long long key = 0;
+
+	for (; *pieces; pieces++) {
+		int piece;
+
+		switch (*pieces) {
+		case 'P':
+			piece = PAWN;
+			break;
+		case 'N':
+			piece = KNIGHT;
+			*phase += 1;
+			break;
+		case 'B':
+			piece = BISHOP;
+			*phase += 1;
+			break;
+		case 'R':
+			piece = ROOK;
+			*phase += 2;
+			break;
+		case 'Q':
+			piece = QUEEN;
+			*phase += 4;
+			break;
+		default:
+			piece = KING;
+		}
+
+		key += MATERIAL_KEY_UNIT(piece + side);
+	}
+
+	return key;
+}
+
+static endgame_t *find_entry(long long material_key) {
+	/* Returns the entry for a material key, or the empty entry where it
+	** would be stored.
+	*/
+	unsigned int index = (unsigned int)((material_key * 0x9e3779b97f4a7c15ULL) >> 56);
+
+	while (endgames[index & (ENDGAME_ENTRIES - 1)].type != ENDGAME_NONE &&
+		   endgames[index & (ENDGAME_ENTRIES - 1)].material_key != material_key)
+		index++;
+
+	return &endgames[index & (ENDGAME_ENTRIES - 1)];
+}
+
+static void add_endgame(const char *strong_pieces, const char *weak_pieces, int type, endgame_func_t func, int value) {
+	/* Adds an endgame for both colours of the strong side. */
+	int strong;
+
+	for (strong = SIDE_WHITE; strong <= SIDE_BLACK; strong++) {
+		int phase = 0;
+		long long key =
+			signature_key(strong_pieces, strong, &phase) + signature_key(weak_pieces, OPPONENT(strong), &phase);
+		endgame_t *entry = find_entry(key);
+
+		entry->material_key = key;
+		entry->type = type;
+		entry->strong = strong;
+		entry->func = func;
+		entry->value = value;
+
+		if (phase > max_phase)
+			max_phase = phase;
+	}
+}
+
+void endgame_init(void) {
+	kpk_init();
+
+	/* Not enough material to mate. */
+	add_endgame("K", "K", ENDGAME_DRAW, NULL, 0);
+	add_endgame("KN", "K", ENDGAME_DRAW, NULL, 0);
+	add_endgame("KB", "K", ENDGAME_DRAW, NULL, 0);
+	add_endgame("KNN", "K", ENDGAME_DRAW, NULL, 0);
+	add_endgame("KN", "KN", ENDGAME_DRAW, NULL, 0);
+	add_endgame("KB", "KN", ENDGAME_DRAW, NULL, 0);
+	add_endgame("KB", "KB", ENDGAME_DRAW, NULL, 0);
+
+	add_endgame("KQ", "K", ENDGAME_EVAL, eval_kxk, 0);
+	add_endgame("KR", "K", ENDGAME_EVAL, eval_kxk, 0);
+	add_endgame("KQQ", "K", ENDGAME_EVAL, eval_kxk, 0);
+	add_endgame("KQR", "K", ENDGAME_EVAL, eval_kxk, 0);
+	add_endgame("KRR", "K", ENDGAME_EVAL, eval_kxk, 0);
+	add_endgame("KBB", "K", ENDGAME_EVAL, eval_kbbk, 0);
+	add_endgame("KBN", "K", ENDGAME_EVAL, eval_kbnk, 0);
+
+	add_endgame("KP", "K", ENDGAME_EXACT, eval_kpk, 0);
+
+	add_endgame("KBP", "K", ENDGAME_SCALE, scale_kbpk, 0);
+	add_endgame("KBPP", "K", ENDGAME_SCALE, scale_kbpk, 0);
+	add_endgame("KBPPP", "K", ENDGAME_SCALE, scale_kbpk, 0);
+
+	add_endgame("KR", "KN", ENDGAME_SCALE, NULL, ENDGAME_SCALE_DRAWISH);
+	add_endgame("KR", "KB", ENDGAME_SCALE, NULL, ENDGAME_SCALE_DRAWISH);
+}
+
+int endgame_max_phase(void) {
+	return max_phase;
+}
+
+int endgame_probe(board_t *board, int *value) {
+	endgame_t *entry;
+
+	if (board->phase > max_phase)
+		return ENDGAME_NONE;
+
+	entry = find_entry(board->material_key);
+
+	switch (entry->type) {
+	case ENDGAME_DRAW:
+		*value = 0;
+		break;
+	case ENDGAME_EVAL:
+	case ENDGAME_EXACT:
+		*value = entry->func(board, entry->strong);
+		if (board->current_player != entry->strong)
+			*value = -*value;
+		break;
+	case ENDGAME_SCALE:
+		*value = entry->func ? entry->func(board, entry->strong) : entry->value;
+	}
+
+	return entry->type;
+}
@@ -0,0 +1,68 @@
+/*  DreamChess
+**
+**  DreamChess is the legal property of its developers, whose names are too
+**  numerous to list here. Please refer to the AUTHORS.txt file distributed
+**  with this source distribution.
+**
+**  This program is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef DREAMER_ENDGAME_H
+#define DREAMER_ENDGAME_H
+
+#include "board.h"
+
+/* Results of endgame_probe(). */
+#define ENDGAME_NONE 0
+#define ENDGAME_DRAW 1
+#define ENDGAME_EVAL 2
+#define ENDGAME_SCALE 3
+#define ENDGAME_EXACT 4
+
+/* Scale factor that leaves the score unchanged. */
+#define ENDGAME_SCALE_NORMAL 64
+
+/* Bonus for positions that are won with correct play. */
+#define ENDGAME_KNOWN_WIN 1000
+
+void endgame_init(void);
+/* Sets up the table of endgames with specialised evaluation.
+** Parameters: (void)
+** Returns   : (void)
+*/
+
+int endgame_max_phase(void);
+/* Retrieves the highest game phase of the endgames in the table.
+** endgame_probe() returns ENDGAME_NONE for boards above it.
+** Parameters: (void)
+** Returns   : (int): The game phase.
+*/
+
+int endgame_probe(board_t *board, int *value);
+/* Looks up the material of a board in the table of endgames.
+** Parameters: (board_t *) board: The board.
+**             (int *) value: Receives the score for the side to move for
+**                 ENDGAME_DRAW, ENDGAME_EVAL and ENDGAME_EXACT, or the
+**                 factor to scale the
+**                 regular evaluation with, relative to
+**                 ENDGAME_SCALE_NORMAL, for ENDGAME_SCALE.
+** Returns   : (int): ENDGAME_DRAW if the material can't win for either
+**                side, ENDGAME_EXACT if the score is known to be a win or
+**                a draw, ENDGAME_EVAL if the score was computed,
+**                ENDGAME_SCALE if the regular evaluation must be scaled,
+**                or ENDGAME_NONE if there is no endgame knowledge for this
+**                material.
+*/
+
+#endif
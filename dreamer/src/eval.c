@@ -18,13 +18,137 @@
 **  along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <assert.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "board.h"
+#include "endgame.h"
 #include "eval.h"
 #include "move.h"
 #include "move_data.h"
+#include "nnue.h"
+#include "thread.h"
+#include "timer.h"
+
+/* Uncomment to compute the full evaluation alongside every lazy evaluation,
+** and check that skipping terms never changes the outcome of a comparison
+** against the alpha-beta window.
+*/
+/* #define LAZY_EVAL_CHECK */
+
+/* Number of entries in the pawn hash table. Must be a power of two. */
+#define PAWN_HASH_ENTRIES (1 << 12)
+
+/* Pawn structure analysis of one side, keyed by the pawn hash key. */
+typedef struct pawn_entry {
+	long long hash_key;
+	/* Side the analysis was done for plus one, or 0 for an empty entry. */
+	int tag;
+	int score;
+	eval_data_t eval_data;
+} pawn_entry_t;
+
+/* The caches are per thread, as their entries are written without locking.
+** They are only allocated by the threads that search, see eval_cache_init(),
+** and other threads evaluate without them.
+*/
+static THREAD_LOCAL pawn_entry_t *pawn_table;
+
+/* Number of entries in the evaluation cache. Must be a power of two. */
+#define EVAL_CACHE_ENTRIES (1 << 16)
+
+/* Complete evaluation of a board, keyed by the hash key of the board. */
+typedef struct eval_entry {
+	long long hash_key;
+	/* Side the evaluation was done for plus one, or 0 for an empty entry. */
+	int tag;
+	/* The evaluation depends on castling history and phantom kings, which
+	** the hash key doesn't cover.
+	*/
+	int castle_flags;
+	int eval;
+} eval_entry_t;
+
+static THREAD_LOCAL eval_entry_t *eval_cache;
+
+static THREAD_LOCAL long long eval_cache_probes;
+static THREAD_LOCAL long long eval_cache_hits;
+
+/* Evaluation weights. */
+enum {
+	PARAM_PAWN_VALUE,
+	PARAM_KNIGHT_VALUE,
+	PARAM_BISHOP_VALUE,
+	PARAM_ROOK_VALUE,
+	PARAM_QUEEN_VALUE,
+	PARAM_DOUBLED_PAWNS,
+	PARAM_ISOLATED_PAWNS,
+	PARAM_EIGHT_PAWNS,
+	PARAM_PAWN_RAM,
+	PARAM_PASSED_PAWN,
+	PARAM_BAD_BISHOP,
+	PARAM_UNDEVELOPED,
+	PARAM_CASTLED,
+	PARAM_CAN_CASTLE_BOTH,
+	PARAM_CAN_CASTLE_KINGSIDE,
+	PARAM_CAN_CASTLE_QUEENSIDE,
+	PARAM_CANNOT_CASTLE,
+	PARAM_ROOK_OPEN_FILE,
+	PARAM_ROOK_HALF_OPEN_FILE,
+	PARAM_ROOK_BEHIND_PASSED,
+	PARAM_TROPISM_ROOK,
+	PARAM_TROPISM_KNIGHT_BASE,
+	PARAM_TROPISM_KNIGHT,
+	PARAM_TROPISM_QUEEN,
+	PARAM_OFFSET,
+	NR_PARAMS
+};
+
+typedef struct eval_param {
+	const char *name;
+	int value;
+} eval_param_t;
+
+static eval_param_t params[NR_PARAMS] = {
+	{"pawn_value", 100},				 /* Material value of a pawn */
+	{"knight_value", 300},				 /* Material value of a knight */
+	{"bishop_value", 350},				 /* Material value of a bishop */
+	{"rook_value", 500},				 /* Material value of a rook */
+	{"queen_value", 900},				 /* Material value of a queen */
+	{"doubled_pawns", -8},				 /* Per file with more than one pawn */
+	{"isolated_pawns", -15},			 /* Per file with pawns but none on the adjacent files */
+	{"eight_pawns", -10},				 /* For having all eight pawns */
+	{"pawn_ram", -8},					 /* Per pawn blocked by an enemy pawn */
+	{"passed_pawn", 1},					 /* Per passed pawn, times the square of its rank */
+	{"bad_bishop", -8},					 /* Per bishop, per own pawn on its square colour */
+	{"undeveloped", -8},				 /* Per piece on its initial square after the queen moved */
+	{"castled", 10},					 /* The following five apply while the enemy queen */
+	{"can_castle_both", -24},			 /* is on the board */
+	{"can_castle_kingside", -40},
+	{"can_castle_queenside", -80},
+	{"cannot_castle", -120},
+	{"rook_open_file", 10},				 /* Per rook on a file without pawns */
+	{"rook_half_open_file", 4},			 /* Per rook on a file with only enemy pawns */
+	{"rook_behind_passed", 25},			 /* Per rook behind an own passed pawn */
+	{"tropism_rook", -2},				 /* Per rook, per rank or file away from the enemy king */
+	{"tropism_knight_base", 5},			 /* Per knight */
+	{"tropism_knight", -1},				 /* Per knight, per square away from the enemy king */
+	{"tropism_queen", -1},				 /* Per queen, per rank or file away from the enemy king */
+	{"offset", 122}};					 /* Makes the starting position score 0 */
+
+#define PARAM(P) (params[P].value)
+
+/* Distance between two squares measured along the nearest rank or file. */
+static unsigned char line_distance[64][64];
+
+/* Distance between two squares measured along ranks and files. */
+static unsigned char manhattan_distance[64][64];
+
+/* Squares on a file and its adjacent files. */
+static bitboard_t neighbour_files[8];
 
 static int min(int a, int b) {
 	if (a < b)
@@ -42,211 +166,102 @@ static int max(int a, int b) {
 
 static int eval_king_tropism(board_t *board, int side) {
 	int score = 0;
-	int square;
-	/* Avoid compiler warnings. */
-	int king_rank = 0;
-	int king_file = 0;
-	int piece_rank;
-	int piece_file;
-	if (side == SIDE_WHITE) {
-		for (square = 0; square < 64; square++)
-			if (board->bitboard[BLACK_KING] & square_bit[square]) {
-				king_rank = square >> 3;
-				king_file = square & 7;
-				break;
-			}
-		/* printf("King on square: %i\n", square); */
-		for (square = 0; square < 64; square++) {
-			piece_rank = square >> 3;
-			piece_file = square & 7;
-
-			if (board->bitboard[WHITE_ROOK] & square_bit[square])
-				score -= min(abs(king_rank - piece_rank), abs(king_file - piece_file)) << 1;
-			else if (board->bitboard[WHITE_KNIGHT] & square_bit[square])
-				score += 5 - abs(king_rank - piece_rank) - abs(king_file - piece_file);
-			else if (board->bitboard[WHITE_QUEEN] & square_bit[square])
-				score -= min(abs(king_rank - piece_rank), abs(king_file - piece_file));
-		}
-	} else {
-		for (square = 0; square < 64; square++)
-			if (board->bitboard[WHITE_KING] & square_bit[square]) {
-				king_rank = square >> 3;
-				king_file = square & 7;
-				break;
-			}
-		/* printf("King on square: %i\n", square); */
-		for (square = 0; square < 64; square++) {
-			piece_rank = square >> 3;
-			piece_file = square & 7;
-
-			if (board->bitboard[BLACK_ROOK] & square_bit[square])
-				score -= min(abs(king_rank - piece_rank), abs(king_file - piece_file)) << 1;
-			else if (board->bitboard[BLACK_KNIGHT] & square_bit[square])
-				score += 5 - abs(king_rank - piece_rank) - abs(king_file - piece_file);
-			else if (board->bitboard[BLACK_QUEEN] & square_bit[square])
-				score -= min(abs(king_rank - piece_rank), abs(king_file - piece_file));
-		}
+	bitboard_t bitboard = board->bitboard[KING + OPPONENT(side)];
+	/* With phantom kings on the board the lowest king is used. */
+	int king = (bitboard ? BIT_FIRST(bitboard) : 0);
+
+	bitboard = board->bitboard[ROOK + side];
+	while (bitboard) {
+		score += line_distance[king][BIT_FIRST(bitboard)] * PARAM(PARAM_TROPISM_ROOK);
+		bitboard &= bitboard - 1;
+	}
+
+	bitboard = board->bitboard[KNIGHT + side];
+	while (bitboard) {
+		score += PARAM(PARAM_TROPISM_KNIGHT_BASE) + manhattan_distance[king][BIT_FIRST(bitboard)] * PARAM(PARAM_TROPISM_KNIGHT);
+		bitboard &= bitboard - 1;
+	}
+
+	bitboard = board->bitboard[QUEEN + side];
+	while (bitboard) {
+		score += line_distance[king][BIT_FIRST(bitboard)] * PARAM(PARAM_TROPISM_QUEEN);
+		bitboard &= bitboard - 1;
 	}
 
 	return score;
 }
 
 static int eval_rook_bonus(board_t *board, eval_data_t *eval_data, int side) {
-	int score = 0;
-	int square;
 	bitboard_t bitboard = board->bitboard[ROOK + side];
-	if (side == SIDE_WHITE) {
-		for (square = 0; square < 64; square++)
-			if (bitboard & square_bit[square]) {
-				int piece_rank = square >> 3;
-				int piece_file = square & 7;
-
-				if (piece_rank == 6)
-					score += 22;
-
-				if (eval_data->max_pawn_file_bins[piece_file] == 0) {
-					if (eval_data->min_pawn_file_bins[piece_file] == 0)
-						score += 10;
-					else
-						score += 4;
-				}
-
-				if (square < eval_data->max_passed_pawns[piece_file])
-					score += 25;
-				bitboard ^= square_bit[square];
-
-				if (!bitboard)
-					return score;
-			}
-	} else {
-		for (square = 63; square >= 0; square--)
-			if (bitboard & square_bit[square]) {
-				int piece_rank = square >> 3;
-				int piece_file = square & 7;
-
-				if (piece_rank == 1)
-					score += 22;
-
-				if (eval_data->max_pawn_file_bins[piece_file] == 0) {
-					if (eval_data->min_pawn_file_bins[piece_file] == 0)
-						score += 10;
-					else
-						score += 4;
-				}
-
-				if (square > eval_data->max_passed_pawns[piece_file])
-					score += 25;
-				bitboard ^= square_bit[square];
-
-				if (!bitboard)
-					return score;
-			}
+	int score = 0;
+
+	while (bitboard) {
+		int square = BIT_FIRST(bitboard);
+		int piece_file = square & 7;
+
+		if (eval_data->max_pawn_file_bins[piece_file] == 0) {
+			if (eval_data->min_pawn_file_bins[piece_file] == 0)
+				score += PARAM(PARAM_ROOK_OPEN_FILE);
+			else
+				score += PARAM(PARAM_ROOK_HALF_OPEN_FILE);
+		}
+
+		if (side == SIDE_WHITE ? square < eval_data->max_passed_pawns[piece_file]
+							   : square > eval_data->max_passed_pawns[piece_file])
+			score += PARAM(PARAM_ROOK_BEHIND_PASSED);
+
+		bitboard &= bitboard - 1;
 	}
 
-	/* Avoid compiler warnings. */
-	return 0;
+	return score;
 }
 
 static int eval_development(board_t *board, int side) {
 	int score = 0;
-	int square;
-	bitboard_t bitboard;
 
 	if (side == SIDE_WHITE) {
-		if (board->bitboard[WHITE_PAWN] & square_bit[SQUARE_D2])
-			score -= 15;
-		if (board->bitboard[WHITE_PAWN] & square_bit[SQUARE_E2])
-			score -= 15;
+		if (board->bitboard[WHITE_QUEEN] && !(board->bitboard[WHITE_QUEEN] & SQUARE_BIT(SQUARE_D1))) {
+			bitboard_t undeveloped = (board->bitboard[WHITE_ROOK] & (SQUARE_BIT(SQUARE_A1) | SQUARE_BIT(SQUARE_H1))) |
+									 (board->bitboard[WHITE_KNIGHT] & (SQUARE_BIT(SQUARE_B1) | SQUARE_BIT(SQUARE_G1))) |
+									 (board->bitboard[WHITE_BISHOP] & (SQUARE_BIT(SQUARE_C1) | SQUARE_BIT(SQUARE_F1)));
 
-		bitboard = board->bitboard[WHITE_KNIGHT] | board->bitboard[WHITE_BISHOP];
-
-		for (square = SQUARE_A1; square <= SQUARE_H1; square++) {
-			if (bitboard & square_bit[square])
-				score -= 10;
-		}
-
-		bitboard = board->bitboard[WHITE_QUEEN];
-
-		if (bitboard && !(bitboard & square_bit[SQUARE_D1])) {
-			int count = 0;
-			if (board->bitboard[WHITE_ROOK] & square_bit[SQUARE_A1])
-				count++;
-			if (board->bitboard[WHITE_ROOK] & square_bit[SQUARE_H1])
-				count++;
-			if (board->bitboard[WHITE_KNIGHT] & square_bit[SQUARE_B1])
-				count++;
-			if (board->bitboard[WHITE_KNIGHT] & square_bit[SQUARE_G1])
-				count++;
-			if (board->bitboard[WHITE_BISHOP] & square_bit[SQUARE_C1])
-				count++;
-			if (board->bitboard[WHITE_BISHOP] & square_bit[SQUARE_F1])
-				count++;
-			/* if (board->bitboard[WHITE_KING] & square_bit[SQUARE_E1])
-				count++; */
-
-			score -= count << 3;
+			score += BIT_COUNT(undeveloped) * PARAM(PARAM_UNDEVELOPED);
 		}
 
 		if (board->bitboard[BLACK_QUEEN]) {
 			if (board->castle_flags & WHITE_HAS_CASTLED)
-				score += 10;
+				score += PARAM(PARAM_CASTLED);
 			else if ((board->castle_flags & WHITE_CAN_CASTLE_KINGSIDE) &&
 					 (board->castle_flags & WHITE_CAN_CASTLE_QUEENSIDE))
-				score -= 24;
+				score += PARAM(PARAM_CAN_CASTLE_BOTH);
 			else if (board->castle_flags & WHITE_CAN_CASTLE_KINGSIDE)
-				score -= 40;
+				score += PARAM(PARAM_CAN_CASTLE_KINGSIDE);
 			else if (board->castle_flags & WHITE_CAN_CASTLE_QUEENSIDE)
-				score -= 80;
+				score += PARAM(PARAM_CAN_CASTLE_QUEENSIDE);
 			else
-				score -= 120;
+				score += PARAM(PARAM_CANNOT_CASTLE);
 		}
 	} else {
-		if (board->bitboard[BLACK_PAWN] & square_bit[SQUARE_D7])
-			score -= 15;
-		if (board->bitboard[BLACK_PAWN] & square_bit[SQUARE_E7])
-			score -= 15;
-
-		bitboard = board->bitboard[BLACK_KNIGHT] | board->bitboard[BLACK_BISHOP];
+		if (board->bitboard[BLACK_QUEEN] && !(board->bitboard[BLACK_QUEEN] & SQUARE_BIT(SQUARE_D8))) {
+			bitboard_t undeveloped = (board->bitboard[BLACK_ROOK] & (SQUARE_BIT(SQUARE_A8) | SQUARE_BIT(SQUARE_H8))) |
+									 (board->bitboard[BLACK_KNIGHT] & (SQUARE_BIT(SQUARE_B8) | SQUARE_BIT(SQUARE_G8))) |
+									 (board->bitboard[BLACK_BISHOP] & (SQUARE_BIT(SQUARE_C8) | SQUARE_BIT(SQUARE_F8)));
 
-		for (square = SQUARE_A8; square <= SQUARE_H8; square++) {
-			if (bitboard & square_bit[square])
-				score -= 10;
-		}
-
-		bitboard = board->bitboard[BLACK_QUEEN];
-
-		if (bitboard && !(bitboard & square_bit[SQUARE_D8])) {
-			int count = 0;
-			if (board->bitboard[BLACK_ROOK] & square_bit[SQUARE_A8])
-				count++;
-			if (board->bitboard[BLACK_ROOK] & square_bit[SQUARE_H8])
-				count++;
-			if (board->bitboard[BLACK_KNIGHT] & square_bit[SQUARE_B8])
-				count++;
-			if (board->bitboard[BLACK_KNIGHT] & square_bit[SQUARE_G8])
-				count++;
-			if (board->bitboard[BLACK_BISHOP] & square_bit[SQUARE_C8])
-				count++;
-			if (board->bitboard[BLACK_BISHOP] & square_bit[SQUARE_F8])
-				count++;
-			/* if (board->bitboard[BLACK_KING] & square_bit[SQUARE_E8])
-				count++; */
-
-			score -= count << 3;
+			score += BIT_COUNT(undeveloped) * PARAM(PARAM_UNDEVELOPED);
 		}
 
 		if (board->bitboard[WHITE_QUEEN]) {
 			if (board->castle_flags & BLACK_HAS_CASTLED)
-				score += 10;
+				score += PARAM(PARAM_CASTLED);
 			else if ((board->castle_flags & BLACK_CAN_CASTLE_KINGSIDE) &&
 					 (board->castle_flags & BLACK_CAN_CASTLE_QUEENSIDE))
-				score -= 24;
+				score += PARAM(PARAM_CAN_CASTLE_BOTH);
 			else if (board->castle_flags & BLACK_CAN_CASTLE_KINGSIDE)
-				score -= 40;
+				score += PARAM(PARAM_CAN_CASTLE_KINGSIDE);
 			else if (board->castle_flags & BLACK_CAN_CASTLE_QUEENSIDE)
-				score -= 80;
+				score += PARAM(PARAM_CAN_CASTLE_QUEENSIDE);
 			else
-				score -= 120;
+				score += PARAM(PARAM_CANNOT_CASTLE);
 		}
 	}
 
@@ -254,168 +269,118 @@ static int eval_development(board_t *board, int side) {
 }
 
 static int eval_bad_bishops(board_t *board, eval_data_t *eval_data, int side) {
-	int square;
-	int score = 0;
 	bitboard_t bitboard = board->bitboard[BISHOP + side];
 
-	if (!bitboard)
-		return 0;
-
-	for (square = 0; square < 64; square++) {
-		if (bitboard & square_bit[square]) {
-			int piece_rank = square >> 3;
-			int piece_file = square & 7;
-
-			if ((piece_rank & 1) == (piece_file & 1))
-				score -= eval_data->max_pawn_color_bins[0] << 3;
-			else
-				score -= eval_data->max_pawn_color_bins[1] << 3;
-
-			bitboard ^= square_bit[square];
+	return (BIT_COUNT(bitboard & DARK_SQUARES) * eval_data->max_pawn_color_bins[0] +
+			BIT_COUNT(bitboard & LIGHT_SQUARES) * eval_data->max_pawn_color_bins[1]) *
+		   PARAM(PARAM_BAD_BISHOP);
+}
 
-			if (!bitboard)
-				return score;
-		}
-	}
+/* Files that contain at least one square of a bitboard, as an 8-bit mask. */
+static int file_set(bitboard_t bitboard) {
+	bitboard |= bitboard >> 32;
+	bitboard |= bitboard >> 16;
+	bitboard |= bitboard >> 8;
+	return (int)(bitboard & 0xff);
+}
 
-	return 0;
+/* Squares of a bitboard and all squares north of them. */
+static bitboard_t fill_north(bitboard_t bitboard) {
+	bitboard |= bitboard << 8;
+	bitboard |= bitboard << 16;
+	bitboard |= bitboard << 32;
+	return bitboard;
 }
 
-static int eval_pawn_structure(board_t *board, eval_data_t *eval_data, int side) {
+static int eval_passed_pawns(eval_data_t *eval_data, int side) {
 	int score = 0;
 	int bin;
 
-	for (bin = 0; bin < 8; bin++)
-		if (eval_data->max_pawn_file_bins[bin] > 1)
-			score -= 8;
-
-	if ((eval_data->max_pawn_file_bins[0] > 0) && eval_data->max_pawn_file_bins[1] == 0)
-		score -= 15;
-	if ((eval_data->max_pawn_file_bins[7] > 0) && eval_data->max_pawn_file_bins[6] == 0)
-		score -= 15;
-
-	for (bin = 1; bin < 7; bin++)
-		if ((eval_data->max_pawn_file_bins[bin] > 0) && (eval_data->max_pawn_file_bins[bin - 1] == 0) &&
-			(eval_data->max_pawn_file_bins[bin + 1] == 0))
-			score -= 15;
-
-	if (eval_data->max_total_pawns == 8)
-		score -= 10;
-
-	score -= 8 * eval_data->pawn_rams;
-
 	if (side == SIDE_WHITE) {
 		for (bin = 0; bin < 8; bin++)
 			if (eval_data->max_passed_pawns[bin] > 0)
-				score += (eval_data->max_passed_pawns[bin] >> 3) * (eval_data->max_passed_pawns[bin] >> 3);
+				score += (eval_data->max_passed_pawns[bin] >> 3) * (eval_data->max_passed_pawns[bin] >> 3) *
+						 PARAM(PARAM_PASSED_PAWN);
 	} else {
 		for (bin = 0; bin < 8; bin++)
 			if (eval_data->max_passed_pawns[bin] < 63)
-				score += (7 - (eval_data->max_passed_pawns[bin] >> 3)) * (7 - (eval_data->max_passed_pawns[bin] >> 3));
+				score += (7 - (eval_data->max_passed_pawns[bin] >> 3)) * (7 - (eval_data->max_passed_pawns[bin] >> 3)) *
+						 PARAM(PARAM_PASSED_PAWN);
 	}
 
 	return score;
 }
 
-static void analyze_pawn_structure(board_t *board, eval_data_t *eval_data, int side) {
-	int i;
-	for (i = 0; i < 8; i++) {
-		eval_data->max_pawn_file_bins[i] = 0;
-		eval_data->min_pawn_file_bins[i] = 0;
-	}
+static int eval_pawn_structure(board_t *board, eval_data_t *eval_data, int side) {
+	bitboard_t pawns = board->bitboard[PAWN + side];
+	int files = file_set(pawns);
+	int score = 0;
 
-	eval_data->max_pawn_color_bins[0] = 0;
-	eval_data->max_pawn_color_bins[1] = 0;
-	eval_data->pawn_rams = 0;
-	eval_data->max_total_pawns = 0;
+	/* Doubled pawns, counted once per file. */
+	score += BIT_COUNT(file_set(pawns & fill_north(pawns << 8))) * PARAM(PARAM_DOUBLED_PAWNS);
 
-	if (side == SIDE_WHITE) {
-		int square;
+	/* Isolated pawns, counted once per file. */
+	score += BIT_COUNT(files & ~((files << 1) | (files >> 1))) * PARAM(PARAM_ISOLATED_PAWNS);
 
-		for (i = 0; i < 8; i++) {
-			eval_data->max_most_advanced[i] = 0;
-			eval_data->min_most_backward[i] = 0;
-			eval_data->max_passed_pawns[i] = 0;
-		}
+	if (eval_data->max_total_pawns == 8)
+		score += PARAM(PARAM_EIGHT_PAWNS);
 
-		for (square = 8; square <= 55; square++) {
-			if (board->bitboard[WHITE_PAWN] & square_bit[square]) {
-				int piece_rank = square >> 3;
-				int piece_file = square & 7;
+	score += eval_data->pawn_rams * PARAM(PARAM_PAWN_RAM);
 
-				eval_data->max_pawn_file_bins[piece_file]++;
-				eval_data->max_total_pawns++;
-				eval_data->max_most_advanced[piece_file] = square;
+	return score + eval_passed_pawns(eval_data, side);
+}
 
-				if ((piece_rank & 1) == (piece_file & 1))
-					eval_data->max_pawn_color_bins[0]++;
-				else
-					eval_data->max_pawn_color_bins[1]++;
-
-				if (board->bitboard[BLACK_PAWN] & square_bit[square + 8])
-					eval_data->pawn_rams++;
-			} else if (board->bitboard[BLACK_PAWN] & square_bit[square]) {
-				int piece_file = square & 7;
-				eval_data->min_pawn_file_bins[piece_file]++;
-				eval_data->min_most_backward[piece_file] = square;
-			}
-		}
+/* Fills in the per-file part of the pawn structure analysis. */
+static void analyze_pawn_files(board_t *board, eval_data_t *eval_data, int side) {
+	bitboard_t own = board->bitboard[PAWN + side];
+	bitboard_t other = board->bitboard[PAWN + OPPONENT(side)];
+	int i;
+
+	for (i = 0; i < 8; i++) {
+		bitboard_t own_file = own & FILE_MASK(i);
+		bitboard_t other_file = other & FILE_MASK(i);
 
-		if (eval_data->max_most_advanced[0] > max(eval_data->min_most_backward[0], eval_data->min_most_backward[1]))
-			eval_data->max_passed_pawns[0] = eval_data->max_most_advanced[0];
+		eval_data->max_pawn_file_bins[i] = BIT_COUNT(own_file);
+		eval_data->min_pawn_file_bins[i] = BIT_COUNT(other_file);
 
-		if (eval_data->max_most_advanced[7] > max(eval_data->min_most_backward[6], eval_data->min_most_backward[7]))
-			eval_data->max_passed_pawns[7] = eval_data->max_most_advanced[7];
+		/* A pawn is passed when no enemy pawn on its own or an adjacent file
+		** is on a higher (for black: lower) square.
+		*/
+		if (side == SIDE_WHITE) {
+			eval_data->max_most_advanced[i] = (own_file ? BIT_LAST(own_file) : 0);
+			eval_data->min_most_backward[i] = (other_file ? BIT_LAST(other_file) : 0);
 
-		for (i = 1; i < 7; i++)
-			if ((eval_data->max_most_advanced[i] > eval_data->min_most_backward[i - 1]) &&
-				(eval_data->max_most_advanced[i] > eval_data->min_most_backward[i]) &&
-				(eval_data->max_most_advanced[i] > eval_data->min_most_backward[i + 1]))
+			if (own_file && !(other & neighbour_files[i] & (~0ULL << eval_data->max_most_advanced[i])))
 				eval_data->max_passed_pawns[i] = eval_data->max_most_advanced[i];
-	} else {
-		int square;
+			else
+				eval_data->max_passed_pawns[i] = 0;
+		} else {
+			eval_data->max_most_advanced[i] = (own_file ? BIT_FIRST(own_file) : 63);
+			eval_data->min_most_backward[i] = (other_file ? BIT_FIRST(other_file) : 63);
 
-		for (i = 0; i < 8; i++) {
-			eval_data->max_most_advanced[i] = 63;
-			eval_data->min_most_backward[i] = 63;
-			eval_data->max_passed_pawns[i] = 63;
+			if (own_file && !(other & neighbour_files[i] & ((1ULL << eval_data->max_most_advanced[i]) - 1)))
+				eval_data->max_passed_pawns[i] = eval_data->max_most_advanced[i];
+			else
+				eval_data->max_passed_pawns[i] = 63;
 		}
+	}
+}
 
-		for (square = 55; square >= 8; square--) {
-			if (board->bitboard[BLACK_PAWN] & square_bit[square]) {
-				int piece_rank = square >> 3;
-				int piece_file = square & 7;
-
-				eval_data->max_pawn_file_bins[piece_file]++;
-				eval_data->max_total_pawns++;
-				eval_data->max_most_advanced[piece_file] = square;
-
-				if ((piece_rank & 1) == (piece_file & 1))
-					eval_data->max_pawn_color_bins[0]++;
-				else
-					eval_data->max_pawn_color_bins[1]++;
-
-				if (board->bitboard[WHITE_PAWN] & square_bit[square - 8])
-					eval_data->pawn_rams++;
-			} else if (board->bitboard[WHITE_PAWN] & square_bit[square]) {
-				int piece_file = square & 7;
-				eval_data->min_pawn_file_bins[piece_file]++;
-				eval_data->min_most_backward[piece_file] = square;
-			}
-		}
+static void analyze_pawn_structure(board_t *board, eval_data_t *eval_data, int side) {
+	bitboard_t own = board->bitboard[PAWN + side];
+	bitboard_t other = board->bitboard[PAWN + OPPONENT(side)];
 
-		if (eval_data->max_most_advanced[0] < min(eval_data->min_most_backward[0], eval_data->min_most_backward[1]))
-			eval_data->max_passed_pawns[0] = eval_data->max_most_advanced[0];
+	eval_data->max_pawn_color_bins[0] = BIT_COUNT(own & DARK_SQUARES);
+	eval_data->max_pawn_color_bins[1] = BIT_COUNT(own & LIGHT_SQUARES);
+	eval_data->max_total_pawns = BIT_COUNT(own);
 
-		if (eval_data->max_most_advanced[7] < min(eval_data->min_most_backward[6], eval_data->min_most_backward[7]))
-			eval_data->max_passed_pawns[7] = eval_data->max_most_advanced[7];
+	/* Pawns that are blocked by an enemy pawn. */
+	if (side == SIDE_WHITE)
+		eval_data->pawn_rams = BIT_COUNT(own & (other >> 8));
+	else
+		eval_data->pawn_rams = BIT_COUNT(own & (other << 8));
 
-		for (i = 1; i < 7; i++)
-			if ((eval_data->max_most_advanced[i] < eval_data->min_most_backward[i - 1]) &&
-				(eval_data->max_most_advanced[i] < eval_data->min_most_backward[i]) &&
-				(eval_data->max_most_advanced[i] < eval_data->min_most_backward[i + 1]))
-				eval_data->max_passed_pawns[i] = eval_data->max_most_advanced[i];
-	}
+	analyze_pawn_files(board, eval_data, side);
 }
 
 static int board_eval_material(board_t *board, int side) {
@@ -447,6 +412,144 @@ static int board_eval_material(board_t *board, int side) {
 	}
 }
 
+static int eval_piece_square(board_t *board, int side) {
+	int phase = min(board->phase, PHASE_MAX);
+	int mg = board->pst_mg[side] - board->pst_mg[OPPONENT(side)];
+	int eg = board->pst_eg[side] - board->pst_eg[OPPONENT(side)];
+
+	return (mg * phase + eg * (PHASE_MAX - phase)) / PHASE_MAX;
+}
+
+static int probe_pawn_structure(board_t *board, eval_data_t *eval_data, int side) {
+	pawn_entry_t *entry;
+
+	if (!pawn_table) {
+		analyze_pawn_structure(board, eval_data, side);
+		return eval_pawn_structure(board, eval_data, side);
+	}
+
+	entry = &pawn_table[(board->pawn_hash_key ^ side) & (PAWN_HASH_ENTRIES - 1)];
+
+	if (entry->tag != side + 1 || entry->hash_key != board->pawn_hash_key) {
+		analyze_pawn_structure(board, &entry->eval_data, side);
+		entry->score = eval_pawn_structure(board, &entry->eval_data, side);
+		entry->hash_key = board->pawn_hash_key;
+		entry->tag = side + 1;
+	}
+
+	*eval_data = entry->eval_data;
+	return entry->score;
+}
+
+void eval_init(void) {
+	int i, j;
+
+	for (i = 0; i < 64; i++)
+		for (j = 0; j < 64; j++) {
+			int rank_distance = abs((i >> 3) - (j >> 3));
+			int file_distance = abs((i & 7) - (j & 7));
+
+			line_distance[i][j] = min(rank_distance, file_distance);
+			manhattan_distance[i][j] = rank_distance + file_distance;
+		}
+
+	for (i = 0; i < 8; i++) {
+		neighbour_files[i] = FILE_MASK(i);
+		if (i > 0)
+			neighbour_files[i] |= FILE_MASK(i - 1);
+		if (i < 7)
+			neighbour_files[i] |= FILE_MASK(i + 1);
+	}
+}
+
+int eval_param_count(void) {
+	return NR_PARAMS;
+}
+
+const char *eval_param_name(int param) {
+	return params[param].name;
+}
+
+int eval_get_param(int param) {
+	return params[param].value;
+}
+
+void eval_set_param(int param, int value) {
+	static const int param_piece[] = {PAWN, KNIGHT, BISHOP, ROOK, QUEEN};
+
+	params[param].value = value;
+
+	if (param <= PARAM_QUEEN_VALUE)
+		board_set_piece_value(param_piece[param], value);
+
+	/* Cached scores were computed with the old weights. */
+	eval_clear_caches();
+}
+
+void eval_clear_caches(void) {
+	if (!pawn_table)
+		return;
+
+	memset(pawn_table, 0, sizeof(pawn_entry_t) * PAWN_HASH_ENTRIES);
+	memset(eval_cache, 0, sizeof(eval_entry_t) * EVAL_CACHE_ENTRIES);
+}
+
+int eval_cache_init(void) {
+	pawn_table = calloc(PAWN_HASH_ENTRIES, sizeof(pawn_entry_t));
+	eval_cache = calloc(EVAL_CACHE_ENTRIES, sizeof(eval_entry_t));
+
+	if (!pawn_table || !eval_cache) {
+		eval_cache_exit();
+		return -1;
+	}
+
+	return 0;
+}
+
+void eval_cache_exit(void) {
+	free(pawn_table);
+	free(eval_cache);
+	pawn_table = NULL;
+	eval_cache = NULL;
+}
+
+int eval_load_params(const char *filename) {
+	FILE *f = fopen(filename, "r");
+	char line[256];
+	int line_nr = 0;
+
+	if (!f) {
+		fprintf(stderr, "Failed to open parameter file '%s'\n", filename);
+		return -1;
+	}
+
+	while (fgets(line, sizeof(line), f)) {
+		char name[64];
+		int value;
+		int i;
+
+		line_nr++;
+
+		if (sscanf(line, "%63s", name) != 1 || name[0] == '#')
+			continue;
+
+		for (i = 0; i < NR_PARAMS; i++)
+			if (!strcmp(name, params[i].name))
+				break;
+
+		if (i == NR_PARAMS || sscanf(line, "%*s %d", &value) != 1) {
+			fprintf(stderr, "Invalid parameter on line %i of '%s'\n", line_nr, filename);
+			fclose(f);
+			return -1;
+		}
+
+		eval_set_param(i, value);
+	}
+
+	fclose(f);
+	return 0;
+}
+
 int board_eval_quick(board_t *board, int side) {
 	int eval = board_eval_material(board, side);
 	if (board->current_player == side)
@@ -455,27 +558,959 @@ int board_eval_quick(board_t *board, int side) {
 		return -eval;
 }
 
-int board_eval_complete(board_t *board, int side, int alpha, int beta) {
+static int lazy_cutoff(board_t *board, int side, int eval1, int eval2, int lower, int upper, int alpha, int beta,
+					   int *eval) {
+	/* Range of the final score, given that the terms still to be computed
+	** add between lower and upper to eval2.
+	*/
+	int min_eval, max_eval;
+
+	if (board->current_player == side) {
+		min_eval = eval1 + eval2 + lower;
+		max_eval = eval1 + eval2 + upper;
+	} else {
+		min_eval = eval1 - eval2 - upper;
+		max_eval = eval1 - eval2 - lower;
+	}
+
+	if (min_eval >= beta) {
+		*eval = beta;
+		return 1;
+	}
+
+	if (max_eval <= alpha) {
+		*eval = alpha;
+		return 1;
+	}
+
+	return 0;
+}
+
+/* Lowest and highest total of a weight that is added at most count times. */
+static int param_min(int param, int count) {
+	return min(0, PARAM(param)) * count;
+}
+
+static int param_max(int param, int count) {
+	return max(0, PARAM(param)) * count;
+}
+
+static void lazy_bounds(board_t *board, int side, int *early_lower, int *early_upper, int *late_lower,
+						int *late_upper) {
+	/* Bounds of development, rook bonus and king tropism (late), and of
+	** pawn structure and bad bishops (early, added to the late bounds).
+	*/
+	int pawns = board->num_pawns[side];
+	int knights = BIT_COUNT(board->bitboard[KNIGHT + side]);
+	int bishops = BIT_COUNT(board->bitboard[BISHOP + side]);
+	int rooks = BIT_COUNT(board->bitboard[ROOK + side]);
+	int queens = BIT_COUNT(board->bitboard[QUEEN + side]);
+	int castle_min = min(min(min(PARAM(PARAM_CASTLED), PARAM(PARAM_CAN_CASTLE_BOTH)),
+							 min(PARAM(PARAM_CAN_CASTLE_KINGSIDE), PARAM(PARAM_CAN_CASTLE_QUEENSIDE))),
+						 min(0, PARAM(PARAM_CANNOT_CASTLE)));
+	int castle_max = max(max(max(PARAM(PARAM_CASTLED), PARAM(PARAM_CAN_CASTLE_BOTH)),
+							 max(PARAM(PARAM_CAN_CASTLE_KINGSIDE), PARAM(PARAM_CAN_CASTLE_QUEENSIDE))),
+						 max(0, PARAM(PARAM_CANNOT_CASTLE)));
+	int file_min = min(0, min(PARAM(PARAM_ROOK_OPEN_FILE), PARAM(PARAM_ROOK_HALF_OPEN_FILE)));
+	int file_max = max(0, max(PARAM(PARAM_ROOK_OPEN_FILE), PARAM(PARAM_ROOK_HALF_OPEN_FILE)));
+
+	*late_lower = param_min(PARAM_UNDEVELOPED, 6) + castle_min +
+				  rooks * (file_min + param_min(PARAM_ROOK_BEHIND_PASSED, 1) + param_min(PARAM_TROPISM_ROOK, 7)) +
+				  knights * (PARAM(PARAM_TROPISM_KNIGHT_BASE) + param_min(PARAM_TROPISM_KNIGHT, 14)) +
+				  queens * param_min(PARAM_TROPISM_QUEEN, 7);
+	*late_upper = param_max(PARAM_UNDEVELOPED, 6) + castle_max +
+				  rooks * (file_max + param_max(PARAM_ROOK_BEHIND_PASSED, 1) + param_max(PARAM_TROPISM_ROOK, 7)) +
+				  knights * (PARAM(PARAM_TROPISM_KNIGHT_BASE) + param_max(PARAM_TROPISM_KNIGHT, 14)) +
+				  queens * param_max(PARAM_TROPISM_QUEEN, 7);
+
+	/* Passed pawns score at most 6 * 6 each. */
+	*early_lower = *late_lower + param_min(PARAM_DOUBLED_PAWNS, pawns / 2) +
+				   param_min(PARAM_ISOLATED_PAWNS, min(pawns, 4)) + param_min(PARAM_EIGHT_PAWNS, 1) +
+				   param_min(PARAM_PAWN_RAM, pawns) + param_min(PARAM_PASSED_PAWN, 36 * pawns) +
+				   param_min(PARAM_BAD_BISHOP, pawns * bishops);
+	*early_upper = *late_upper + param_max(PARAM_DOUBLED_PAWNS, pawns / 2) +
+				   param_max(PARAM_ISOLATED_PAWNS, min(pawns, 4)) + param_max(PARAM_EIGHT_PAWNS, 1) +
+				   param_max(PARAM_PAWN_RAM, pawns) + param_max(PARAM_PASSED_PAWN, 36 * pawns) +
+				   param_max(PARAM_BAD_BISHOP, pawns * bishops);
+}
+
+static void eval_cache_store(eval_entry_t *entry, board_t *board, int side, int eval) {
+	if (!entry)
+		return;
+
+	entry->hash_key = board->hash_key;
+	entry->tag = side + 1;
+	entry->castle_flags = board->castle_flags;
+	entry->eval = eval;
+}
+
+static int eval_complete(board_t *board, int side, int alpha, int beta) {
+	eval_entry_t *entry = NULL;
 	eval_data_t eval_data;
+	int early_lower, early_upper;
+	int late_lower, late_upper;
+	int scale = ENDGAME_SCALE_NORMAL;
 	int eval2;
-	int eval1 = board_eval_material(board, side);
+	int eval1;
+	int eval;
+
+	if (eval_cache) {
+		entry = &eval_cache[(board->hash_key ^ side) & (EVAL_CACHE_ENTRIES - 1)];
+		eval_cache_probes++;
+
+		if (entry->tag == side + 1 && entry->hash_key == board->hash_key &&
+			entry->castle_flags == board->castle_flags) {
+			eval_cache_hits++;
+			return entry->eval;
+		}
+	}
+
+	switch (endgame_probe(board, &eval)) {
+	case ENDGAME_DRAW:
+	case ENDGAME_EVAL:
+	case ENDGAME_EXACT:
+		eval_cache_store(entry, board, side, eval);
+		return eval;
+	case ENDGAME_SCALE:
+		/* The lazy bounds don't hold for scaled scores. */
+		scale = eval;
+		alpha = INT_MIN;
+		beta = INT_MAX;
+	}
+
+	if (nnue_enabled) {
+		eval1 = nnue_evaluate(board) * scale / ENDGAME_SCALE_NORMAL;
+		eval_cache_store(entry, board, side, eval1);
+		return eval1;
+	}
+
+	eval1 = board_eval_material(board, side);
 
 	if (board->current_player != side)
 		eval1 = -eval1;
-#if 0
-    if (eval1 - 200 >= beta)
-        return beta;
 
-    if (eval1 + 200 <= alpha)
-        return alpha;
+	eval2 = eval_piece_square(board, side) + PARAM(PARAM_OFFSET);
+
+	lazy_bounds(board, side, &early_lower, &early_upper, &late_lower, &late_upper);
+
+	if (lazy_cutoff(board, side, eval1, eval2, early_lower, early_upper, alpha, beta, &eval))
+		return eval;
+
+	eval2 += probe_pawn_structure(board, &eval_data, side) + eval_bad_bishops(board, &eval_data, side);
+
+	if (lazy_cutoff(board, side, eval1, eval2, late_lower, late_upper, alpha, beta, &eval))
+		return eval;
+
+	eval2 += eval_development(board, side) + eval_rook_bonus(board, &eval_data, side) + eval_king_tropism(board, side);
+
+	if (board->current_player == side)
+		eval1 += eval2;
+	else
+		eval1 -= eval2;
+
+	eval1 = eval1 * scale / ENDGAME_SCALE_NORMAL;
+
+	eval_cache_store(entry, board, side, eval1);
+	return eval1;
+}
+
+int board_eval_complete(board_t *board, int side, int alpha, int beta) {
+#ifdef LAZY_EVAL_CHECK
+	int eval = eval_complete(board, side, alpha, beta);
+	int full = eval_complete(board, side, INT_MIN, INT_MAX);
+
+	assert(eval == full || (eval == beta && full >= beta) || (eval == alpha && full <= alpha));
+	return eval;
+#else
+	return eval_complete(board, side, alpha, beta);
 #endif
+}
+
+void eval_cache_stats(long long *probes, long long *hits) {
+	*probes = eval_cache_probes;
+	*hits = eval_cache_hits;
+	eval_cache_probes = 0;
+	eval_cache_hits = 0;
+}
+
+static int eval_full(board_t *board, int side) {
+	eval_data_t eval_data;
+	int scale = ENDGAME_SCALE_NORMAL;
+	int eval1;
+	int eval2;
+
+	switch (endgame_probe(board, &eval1)) {
+	case ENDGAME_DRAW:
+	case ENDGAME_EVAL:
+	case ENDGAME_EXACT:
+		return eval1;
+	case ENDGAME_SCALE:
+		scale = eval1;
+	}
+
+	if (nnue_enabled)
+		return nnue_evaluate(board) * scale / ENDGAME_SCALE_NORMAL;
+
+	eval1 = board_eval_material(board, side);
+
+	if (board->current_player != side)
+		eval1 = -eval1;
+
+	/* The pawn hash table is not shared between threads. */
 	analyze_pawn_structure(board, &eval_data, side);
-	eval2 = eval_pawn_structure(board, &eval_data, side) + eval_bad_bishops(board, &eval_data, side) +
-			eval_development(board, side) + eval_rook_bonus(board, &eval_data, side) + eval_king_tropism(board, side) +
-			192; /* Add 192 to have the starting position score 0 */
+
+	eval2 = eval_piece_square(board, side) + PARAM(PARAM_OFFSET) + eval_pawn_structure(board, &eval_data, side) +
+			eval_bad_bishops(board, &eval_data, side) + eval_development(board, side) +
+			eval_rook_bonus(board, &eval_data, side) + eval_king_tropism(board, side);
 
 	if (board->current_player == side)
-		return eval1 + eval2;
+		eval1 += eval2;
 	else
-		return eval1 - eval2;
+		eval1 -= eval2;
+
+	return eval1 * scale / ENDGAME_SCALE_NORMAL;
+}
+
+int eval_positions_add(eval_positions_t *positions, const board_t *board) {
+	int piece;
+
+	if (positions->count == positions->size) {
+		int size = positions->size ? positions->size * 2 : 65536;
+		int *current_player;
+		int *castle_flags;
+
+		for (piece = 0; piece < NR_PIECES; piece++) {
+			bitboard_t *pieces = realloc(positions->pieces[piece], size * sizeof(bitboard_t));
+
+			if (!pieces)
+				return -1;
+
+			positions->pieces[piece] = pieces;
+		}
+
+		current_player = realloc(positions->current_player, size * sizeof(int));
+		if (!current_player)
+			return -1;
+		positions->current_player = current_player;
+
+		castle_flags = realloc(positions->castle_flags, size * sizeof(int));
+		if (!castle_flags)
+			return -1;
+		positions->castle_flags = castle_flags;
+
+		positions->size = size;
+	}
+
+	for (piece = 0; piece < NR_PIECES; piece++)
+		positions->pieces[piece][positions->count] = board->bitboard[piece];
+
+	positions->current_player[positions->count] = board->current_player;
+	positions->castle_flags[positions->count] = board->castle_flags;
+	positions->count++;
+
+	return 0;
+}
+
+void eval_positions_free(eval_positions_t *positions) {
+	int piece;
+
+	for (piece = 0; piece < NR_PIECES; piece++)
+		free(positions->pieces[piece]);
+
+	free(positions->current_player);
+	free(positions->castle_flags);
+	memset(positions, 0, sizeof(eval_positions_t));
+}
+
+/* Number of positions whose set-wise terms eval_batch() computes together. */
+#define EVAL_BATCH_LANES 64
+
+/* Maximum number of threads used by eval_batch(). */
+#define EVAL_BATCH_THREADS 64
+
+/* Evaluates up to EVAL_BATCH_LANES positions, starting at first. The terms
+** that only count squares of bitboards are computed across all positions at
+** once, one term at a time, in loops the compiler can vectorise. The terms
+** that look at single squares follow per position, on a board that only
+** holds the bitboards and totals they read. Positions that may be endgames
+** with their own evaluation, or that hold phantom kings, are set up and
+** evaluated in full instead.
+*/
+static void batch_lanes(const eval_positions_t *positions, int first, int count, int *results) {
+	const bitboard_t *white_pawns = positions->pieces[WHITE_PAWN] + first;
+	const bitboard_t *black_pawns = positions->pieces[BLACK_PAWN] + first;
+	const bitboard_t *white_bishops = positions->pieces[WHITE_BISHOP] + first;
+	const bitboard_t *black_bishops = positions->pieces[BLACK_BISHOP] + first;
+	const bitboard_t *white_queens = positions->pieces[WHITE_QUEEN] + first;
+	const bitboard_t *black_queens = positions->pieces[BLACK_QUEEN] + first;
+	const int *current_player = positions->current_player + first;
+	const int *castle_flags = positions->castle_flags + first;
+	int material[2][EVAL_BATCH_LANES];
+	int pawns[2][EVAL_BATCH_LANES];
+	int phase[EVAL_BATCH_LANES];
+	int score[EVAL_BATCH_LANES];
+	int max_phase = endgame_max_phase();
+	board_t board;
+	int piece;
+	int i;
+
+	/* Material and game phase. */
+	for (i = 0; i < count; i++) {
+		material[SIDE_WHITE][i] = 0;
+		material[SIDE_BLACK][i] = 0;
+		phase[i] = 0;
+	}
+
+	for (piece = 0; piece < NR_PIECES; piece++) {
+		const bitboard_t *bitboards = positions->pieces[piece] + first;
+		int *total = material[piece & 1];
+		int value = board_piece_value(piece);
+		int piece_phase = board_piece_phase(piece);
+
+		for (i = 0; i < count; i++) {
+			int pieces = BIT_COUNT(bitboards[i]);
+
+			total[i] += pieces * value;
+			phase[i] += pieces * piece_phase;
+		}
+	}
+
+	for (i = 0; i < count; i++) {
+		pawns[SIDE_WHITE][i] = BIT_COUNT(white_pawns[i]);
+		pawns[SIDE_BLACK][i] = BIT_COUNT(black_pawns[i]);
+	}
+
+	/* Pawn structure without the passed pawns, and bad bishops. */
+	{
+		int doubled_pawns = PARAM(PARAM_DOUBLED_PAWNS);
+		int isolated_pawns = PARAM(PARAM_ISOLATED_PAWNS);
+		int eight_pawns = PARAM(PARAM_EIGHT_PAWNS);
+		int pawn_ram = PARAM(PARAM_PAWN_RAM);
+		int bad_bishop = PARAM(PARAM_BAD_BISHOP);
+
+		for (i = 0; i < count; i++) {
+			int white = (current_player[i] == SIDE_WHITE);
+			bitboard_t own = (white ? white_pawns[i] : black_pawns[i]);
+			bitboard_t other = (white ? black_pawns[i] : white_pawns[i]);
+			bitboard_t bishops = (white ? white_bishops[i] : black_bishops[i]);
+			bitboard_t blocked = (white ? other >> 8 : other << 8);
+			int files = file_set(own);
+
+			score[i] = BIT_COUNT(file_set(own & fill_north(own << 8))) * doubled_pawns +
+					   BIT_COUNT(files & ~((files << 1) | (files >> 1))) * isolated_pawns +
+					   (BIT_COUNT(own) == 8 ? eight_pawns : 0) + BIT_COUNT(own & blocked) * pawn_ram +
+					   (BIT_COUNT(bishops & DARK_SQUARES) * BIT_COUNT(own & DARK_SQUARES) +
+						BIT_COUNT(bishops & LIGHT_SQUARES) * BIT_COUNT(own & LIGHT_SQUARES)) *
+						   bad_bishop;
+		}
+	}
+
+	/* Development. Black's initial squares are white's moved up 56 squares,
+	** and black's castling flags are white's moved up one bit.
+	*/
+	{
+		const bitboard_t *rooks[2] = {positions->pieces[WHITE_ROOK] + first, positions->pieces[BLACK_ROOK] + first};
+		const bitboard_t *knights[2] = {positions->pieces[WHITE_KNIGHT] + first,
+										positions->pieces[BLACK_KNIGHT] + first};
+		int undeveloped = PARAM(PARAM_UNDEVELOPED);
+
+		for (i = 0; i < count; i++) {
+			int side = current_player[i];
+			int shift = (side == SIDE_WHITE ? 0 : 56);
+			bitboard_t queens = (side == SIDE_WHITE ? white_queens[i] : black_queens[i]);
+			bitboard_t bishops = (side == SIDE_WHITE ? white_bishops[i] : black_bishops[i]);
+			bitboard_t pieces = (rooks[side][i] & ((SQUARE_BIT(SQUARE_A1) | SQUARE_BIT(SQUARE_H1)) << shift)) |
+								(knights[side][i] & ((SQUARE_BIT(SQUARE_B1) | SQUARE_BIT(SQUARE_G1)) << shift)) |
+								(bishops & ((SQUARE_BIT(SQUARE_C1) | SQUARE_BIT(SQUARE_F1)) << shift));
+
+			if (queens && !(queens & (SQUARE_BIT(SQUARE_D1) << shift)))
+				score[i] += BIT_COUNT(pieces) * undeveloped;
+		}
+
+		for (i = 0; i < count; i++) {
+			int side = current_player[i];
+			int flags = castle_flags[i] >> side;
+
+			if (!(side == SIDE_WHITE ? black_queens[i] : white_queens[i]))
+				continue;
+
+			if (flags & WHITE_HAS_CASTLED)
+				score[i] += PARAM(PARAM_CASTLED);
+			else if ((flags & WHITE_CAN_CASTLE_KINGSIDE) && (flags & WHITE_CAN_CASTLE_QUEENSIDE))
+				score[i] += PARAM(PARAM_CAN_CASTLE_BOTH);
+			else if (flags & WHITE_CAN_CASTLE_KINGSIDE)
+				score[i] += PARAM(PARAM_CAN_CASTLE_KINGSIDE);
+			else if (flags & WHITE_CAN_CASTLE_QUEENSIDE)
+				score[i] += PARAM(PARAM_CAN_CASTLE_QUEENSIDE);
+			else
+				score[i] += PARAM(PARAM_CANNOT_CASTLE);
+		}
+	}
+
+	for (i = 0; i < count; i++) {
+		bitboard_t pieces[NR_PIECES];
+		eval_data_t eval_data;
+		int side = current_player[i];
+		int eval;
+
+		for (piece = 0; piece < NR_PIECES; piece++)
+			pieces[piece] = positions->pieces[piece][first + i];
+
+		if (nnue_enabled || phase[i] <= max_phase || (castle_flags[i] & PHANTOM_FLAGS)) {
+			setup_board_bitboards(&board, pieces, side, castle_flags[i]);
+			results[first + i] = eval_full(&board, side);
+			continue;
+		}
+
+		memcpy(board.bitboard, pieces, sizeof(pieces));
+		board.material_value[SIDE_WHITE] = material[SIDE_WHITE][i];
+		board.material_value[SIDE_BLACK] = material[SIDE_BLACK][i];
+		board.num_pawns[SIDE_WHITE] = pawns[SIDE_WHITE][i];
+		board.num_pawns[SIDE_BLACK] = pawns[SIDE_BLACK][i];
+		board.phase = phase[i];
+		board_piece_square_totals(pieces, board.pst_mg, board.pst_eg);
+
+		analyze_pawn_files(&board, &eval_data, side);
+
+		eval = board_eval_material(&board, side) + eval_piece_square(&board, side) + PARAM(PARAM_OFFSET) + score[i] +
+			   eval_passed_pawns(&eval_data, side) + eval_rook_bonus(&board, &eval_data, side) +
+			   eval_king_tropism(&board, side);
+
+		results[first + i] = eval;
+	}
+}
+
+/* Range of positions evaluated by one thread. */
+typedef struct batch_job {
+	const eval_positions_t *positions;
+	int *results;
+	int first;
+	int last;
+} batch_job_t;
+
+static int batch_thread(void *data) {
+	batch_job_t *job = data;
+	int first;
+
+	for (first = job->first; first < job->last; first += EVAL_BATCH_LANES)
+		batch_lanes(job->positions, first, min(job->last - first, EVAL_BATCH_LANES), job->results);
+
+	return 0;
+}
+
+void eval_batch(const eval_positions_t *positions, int first, int last, int *results, int threads) {
+	batch_job_t jobs[EVAL_BATCH_THREADS];
+	thread_t *handles[EVAL_BATCH_THREADS];
+	int count = last - first;
+	int i;
+
+	if (threads <= 0)
+		threads = thread_cpu_count();
+	if (threads > EVAL_BATCH_THREADS)
+		threads = EVAL_BATCH_THREADS;
+
+	for (i = 0; i < threads; i++) {
+		jobs[i].positions = positions;
+		jobs[i].results = results;
+		jobs[i].first = first + (int)((long long)count * i / threads);
+		jobs[i].last = first + (int)((long long)count * (i + 1) / threads);
+	}
+
+	/* The calling thread takes the first range. If a thread can't be
+	** started, its range is evaluated by the calling thread as well.
+	*/
+	for (i = 1; i < threads; i++)
+		handles[i] = thread_create(batch_thread, &jobs[i]);
+
+	batch_thread(&jobs[0]);
+
+	for (i = 1; i < threads; i++) {
+		if (handles[i])
+			thread_join(handles[i]);
+		else
+			batch_thread(&jobs[i]);
+	}
+}
+
+/* Number and length of the random games played by eval_benchmark(), and the
+** number of positions kept from them for the batch benchmark.
+*/
+#define BENCH_GAMES 2000
+#define BENCH_PLIES 200
+#define BENCH_POSITIONS 200000
+
+static long bench_games(int evaluate, eval_positions_t *positions) {
+	board_t board;
+	long evals = 0;
+	int game;
+
+	srand(1);
+
+	for (game = 0; game < BENCH_GAMES; game++) {
+		int ply;
+
+		setup_board(&board);
+
+		for (ply = 0; ply < BENCH_PLIES; ply++) {
+			int tries;
+			int count;
+
+			if (evaluate) {
+				board_eval_complete(&board, board.current_player, INT_MIN, INT_MAX);
+				evals++;
+			}
+
+			/* Positions that don't fit are left out. */
+			if (positions && positions->count < BENCH_POSITIONS)
+				eval_positions_add(positions, &board);
+
+			compute_legal_moves(&board, 0);
+			count = moves_start[1] - moves_start[0];
+
+			/* Try random moves until a legal one is found. */
+			for (tries = 0; tries < 50; tries++) {
+				bitboard_t en_passant = board.en_passant;
+				int castle_flags = board.castle_flags;
+				int fifty_moves = board.fifty_moves;
+				move_t move = moves[moves_start[0] + rand() % count];
+
+				execute_move(&board, move);
+				if (compute_legal_moves(&board, 1) >= 0)
+					break;
+				unmake_move(&board, move, en_passant, castle_flags, fifty_moves);
+			}
+
+			if (tries == 50)
+				break;
+		}
+	}
+
+	return evals;
+}
+
+static double bench_seconds(timer *t) {
+	double seconds = timer_get(t) / 100.0;
+	return (seconds > 0.01 ? seconds : 0.01);
+}
+
+static void bench_batch(const eval_positions_t *positions) {
+	int count = positions->count;
+	int *results = malloc(sizeof(int) * count);
+	int *batch_results = malloc(sizeof(int) * count);
+	int threads = thread_cpu_count();
+	int mismatches = 0;
+	board_t board;
+	timer t;
+	int i;
+
+	if (!results || !batch_results) {
+		fprintf(stderr, "Failed to allocate memory for batch benchmark\n");
+		free(results);
+		free(batch_results);
+		return;
+	}
+
+	eval_clear_caches();
+	timer_init(&t, 0);
+	timer_start(&t);
+	for (i = 0; i < count; i++) {
+		bitboard_t pieces[NR_PIECES];
+		int piece;
+
+		for (piece = 0; piece < NR_PIECES; piece++)
+			pieces[piece] = positions->pieces[piece][i];
+
+		setup_board_bitboards(&board, pieces, positions->current_player[i], positions->castle_flags[i]);
+		results[i] = board_eval_complete(&board, board.current_player, INT_MIN, INT_MAX);
+	}
+	printf("Single evaluation: %d positions, %.0f positions/s\n", count, count / bench_seconds(&t));
+
+	timer_init(&t, 0);
+	timer_start(&t);
+	eval_batch(positions, 0, count, batch_results, 1);
+	printf("Batch evaluation, 1 thread: %.0f positions/s\n", count / bench_seconds(&t));
+
+	timer_init(&t, 0);
+	timer_start(&t);
+	eval_batch(positions, 0, count, batch_results, threads);
+	printf("Batch evaluation, %d thread(s): %.0f positions/s\n", threads, count / bench_seconds(&t));
+
+	for (i = 0; i < count; i++)
+		if (results[i] != batch_results[i])
+			mismatches++;
+
+	if (mismatches)
+		printf("Batch evaluation differs for %d positions\n", mismatches);
+
+	free(results);
+	free(batch_results);
+}
+
+void eval_benchmark(void) {
+	eval_positions_t positions;
+	int nnue = nnue_enabled;
+	double moves_time;
+	double eval_time;
+	long evals;
+	timer t;
+
+	nnue_enabled = 0;
+
+	/* Measures evaluation as the search does it, through the caches. If
+	** they can't be allocated, evaluation is measured without them.
+	*/
+	eval_cache_init();
+
+	timer_init(&t, 0);
+	timer_start(&t);
+	bench_games(0, NULL);
+	moves_time = bench_seconds(&t);
+
+	eval_clear_caches();
+	timer_init(&t, 0);
+	timer_start(&t);
+	evals = bench_games(1, NULL);
+	eval_time = bench_seconds(&t) - moves_time;
+	printf("Classic evaluation: %ld positions, %.0f evals/s\n", evals, evals / (eval_time > 0.01 ? eval_time : 0.01));
+
+	if (nnue) {
+		nnue_enabled = 1;
+
+		/* Includes the incremental updates while making moves. */
+		eval_clear_caches();
+		timer_init(&t, 0);
+		timer_start(&t);
+		evals = bench_games(1, NULL);
+		eval_time = bench_seconds(&t) - moves_time;
+		printf("Network evaluation (%s): %ld positions, %.0f evals/s\n", nnue_kernels(), evals,
+			   evals / (eval_time > 0.01 ? eval_time : 0.01));
+	}
+
+	memset(&positions, 0, sizeof(positions));
+	bench_games(0, &positions);
+	bench_batch(&positions);
+
+	eval_positions_free(&positions);
+	eval_cache_exit();
+
+	nnue_enabled = nnue;
+}
+
+/* Square-by-square versions of the set-wise evaluation terms, used by
+** eval_check().
+*/
+
+static int check_king_tropism(board_t *board, int side) {
+	int score = 0;
+	int square;
+	int king_rank = 0;
+	int king_file = 0;
+
+	for (square = 0; square < 64; square++)
+		if (board->bitboard[KING + OPPONENT(side)] & square_bit[square]) {
+			king_rank = square >> 3;
+			king_file = square & 7;
+			break;
+		}
+
+	for (square = 0; square < 64; square++) {
+		int rank_distance = abs(king_rank - (square >> 3));
+		int file_distance = abs(king_file - (square & 7));
+
+		if (board->bitboard[ROOK + side] & square_bit[square])
+			score += min(rank_distance, file_distance) * PARAM(PARAM_TROPISM_ROOK);
+		else if (board->bitboard[KNIGHT + side] & square_bit[square])
+			score += PARAM(PARAM_TROPISM_KNIGHT_BASE) + (rank_distance + file_distance) * PARAM(PARAM_TROPISM_KNIGHT);
+		else if (board->bitboard[QUEEN + side] & square_bit[square])
+			score += min(rank_distance, file_distance) * PARAM(PARAM_TROPISM_QUEEN);
+	}
+
+	return score;
+}
+
+static int check_rook_bonus(board_t *board, eval_data_t *eval_data, int side) {
+	int score = 0;
+	int square;
+
+	for (square = 0; square < 64; square++)
+		if (board->bitboard[ROOK + side] & square_bit[square]) {
+			int piece_file = square & 7;
+
+			if (eval_data->max_pawn_file_bins[piece_file] == 0) {
+				if (eval_data->min_pawn_file_bins[piece_file] == 0)
+					score += PARAM(PARAM_ROOK_OPEN_FILE);
+				else
+					score += PARAM(PARAM_ROOK_HALF_OPEN_FILE);
+			}
+
+			if (side == SIDE_WHITE ? square < eval_data->max_passed_pawns[piece_file]
+								   : square > eval_data->max_passed_pawns[piece_file])
+				score += PARAM(PARAM_ROOK_BEHIND_PASSED);
+		}
+
+	return score;
+}
+
+static int check_development(board_t *board, int side) {
+	/* Initial squares of the rooks, knights and bishops, from a to h. */
+	static const int pieces[6] = {ROOK, KNIGHT, BISHOP, BISHOP, KNIGHT, ROOK};
+	static const int files[6] = {0, 1, 2, 5, 6, 7};
+	int rank = (side == SIDE_WHITE ? 0 : 7);
+	int score = 0;
+	int i;
+
+	if (board->bitboard[QUEEN + side] && !(board->bitboard[QUEEN + side] & square_bit[rank * 8 + 3]))
+		for (i = 0; i < 6; i++)
+			if (board->bitboard[pieces[i] + side] & square_bit[rank * 8 + files[i]])
+				score += PARAM(PARAM_UNDEVELOPED);
+
+	if (board->bitboard[QUEEN + OPPONENT(side)]) {
+		int flags = board->castle_flags;
+
+		if (side == SIDE_BLACK)
+			flags >>= 1;
+
+		if (flags & WHITE_HAS_CASTLED)
+			score += PARAM(PARAM_CASTLED);
+		else if ((flags & WHITE_CAN_CASTLE_KINGSIDE) && (flags & WHITE_CAN_CASTLE_QUEENSIDE))
+			score += PARAM(PARAM_CAN_CASTLE_BOTH);
+		else if (flags & WHITE_CAN_CASTLE_KINGSIDE)
+			score += PARAM(PARAM_CAN_CASTLE_KINGSIDE);
+		else if (flags & WHITE_CAN_CASTLE_QUEENSIDE)
+			score += PARAM(PARAM_CAN_CASTLE_QUEENSIDE);
+		else
+			score += PARAM(PARAM_CANNOT_CASTLE);
+	}
+
+	return score;
+}
+
+static int check_bad_bishops(board_t *board, eval_data_t *eval_data, int side) {
+	int score = 0;
+	int square;
+
+	for (square = 0; square < 64; square++)
+		if (board->bitboard[BISHOP + side] & square_bit[square]) {
+			if (((square >> 3) & 1) == (square & 1))
+				score += eval_data->max_pawn_color_bins[0] * PARAM(PARAM_BAD_BISHOP);
+			else
+				score += eval_data->max_pawn_color_bins[1] * PARAM(PARAM_BAD_BISHOP);
+		}
+
+	return score;
+}
+
+static void check_analyze_pawn_structure(board_t *board, eval_data_t *eval_data, int side) {
+	int most_advanced = (side == SIDE_WHITE ? 0 : 63);
+	int square;
+	int i;
+
+	for (i = 0; i < 8; i++) {
+		eval_data->max_pawn_file_bins[i] = 0;
+		eval_data->min_pawn_file_bins[i] = 0;
+		eval_data->max_most_advanced[i] = most_advanced;
+		eval_data->min_most_backward[i] = most_advanced;
+		eval_data->max_passed_pawns[i] = most_advanced;
+	}
+
+	eval_data->max_pawn_color_bins[0] = 0;
+	eval_data->max_pawn_color_bins[1] = 0;
+	eval_data->pawn_rams = 0;
+	eval_data->max_total_pawns = 0;
+
+	/* White scans towards rank 8 and black towards rank 1, so that the last
+	** pawn seen on a file is the most advanced one of the side to evaluate.
+	*/
+	for (i = 8; i <= 55; i++) {
+		square = (side == SIDE_WHITE ? i : 63 - i);
+
+		if (board->bitboard[PAWN + side] & square_bit[square]) {
+			int piece_file = square & 7;
+
+			eval_data->max_pawn_file_bins[piece_file]++;
+			eval_data->max_total_pawns++;
+			eval_data->max_most_advanced[piece_file] = square;
+
+			if (((square >> 3) & 1) == (piece_file & 1))
+				eval_data->max_pawn_color_bins[0]++;
+			else
+				eval_data->max_pawn_color_bins[1]++;
+
+			if (board->bitboard[PAWN + OPPONENT(side)] & square_bit[side == SIDE_WHITE ? square + 8 : square - 8])
+				eval_data->pawn_rams++;
+		} else if (board->bitboard[PAWN + OPPONENT(side)] & square_bit[square]) {
+			int piece_file = square & 7;
+
+			eval_data->min_pawn_file_bins[piece_file]++;
+			eval_data->min_most_backward[piece_file] = square;
+		}
+	}
+
+	for (i = 0; i < 8; i++) {
+		int backward = eval_data->min_most_backward[i];
+
+		if (i > 0)
+			backward = (side == SIDE_WHITE ? max(backward, eval_data->min_most_backward[i - 1])
+										   : min(backward, eval_data->min_most_backward[i - 1]));
+		if (i < 7)
+			backward = (side == SIDE_WHITE ? max(backward, eval_data->min_most_backward[i + 1])
+										   : min(backward, eval_data->min_most_backward[i + 1]));
+
+		if (side == SIDE_WHITE ? eval_data->max_most_advanced[i] > backward
+							   : eval_data->max_most_advanced[i] < backward)
+			eval_data->max_passed_pawns[i] = eval_data->max_most_advanced[i];
+	}
+}
+
+static int check_pawn_structure(eval_data_t *eval_data, int side) {
+	int score = 0;
+	int bin;
+
+	for (bin = 0; bin < 8; bin++) {
+		int left = (bin > 0 ? eval_data->max_pawn_file_bins[bin - 1] : 0);
+		int right = (bin < 7 ? eval_data->max_pawn_file_bins[bin + 1] : 0);
+
+		if (eval_data->max_pawn_file_bins[bin] > 1)
+			score += PARAM(PARAM_DOUBLED_PAWNS);
+
+		if (eval_data->max_pawn_file_bins[bin] > 0 && left == 0 && right == 0)
+			score += PARAM(PARAM_ISOLATED_PAWNS);
+
+		if (side == SIDE_WHITE ? eval_data->max_passed_pawns[bin] > 0 : eval_data->max_passed_pawns[bin] < 63) {
+			int rank = eval_data->max_passed_pawns[bin] >> 3;
+
+			if (side == SIDE_BLACK)
+				rank = 7 - rank;
+
+			score += rank * rank * PARAM(PARAM_PASSED_PAWN);
+		}
+	}
+
+	if (eval_data->max_total_pawns == 8)
+		score += PARAM(PARAM_EIGHT_PAWNS);
+
+	score += eval_data->pawn_rams * PARAM(PARAM_PAWN_RAM);
+
+	return score;
+}
+
+/* Number of differences printed by eval_check(). */
+#define CHECK_REPORTS 20
+
+/* Compares one value for one position and side, and counts and reports a
+** difference.
+*/
+static void check_term(int *differences, const char *term, int position, int side, int score, int check_score) {
+	if (score == check_score)
+		return;
+
+	if (++*differences <= CHECK_REPORTS)
+		printf("Position %d, %s: %s is %d instead of %d\n", position, (side == SIDE_WHITE ? "white" : "black"),
+			   term, score, check_score);
+}
+
+/* Compares the pawn structure analysis and its score for one side. */
+static void check_pawns(int *differences, board_t *board, int position, int side) {
+	eval_data_t eval_data;
+	eval_data_t check_data;
+	int i;
+
+	analyze_pawn_structure(board, &eval_data, side);
+	check_analyze_pawn_structure(board, &check_data, side);
+
+	for (i = 0; i < 8; i++) {
+		check_term(differences, "own pawns on a file", position, side, eval_data.max_pawn_file_bins[i],
+				   check_data.max_pawn_file_bins[i]);
+		check_term(differences, "enemy pawns on a file", position, side, eval_data.min_pawn_file_bins[i],
+				   check_data.min_pawn_file_bins[i]);
+		check_term(differences, "most advanced pawn", position, side, eval_data.max_most_advanced[i],
+				   check_data.max_most_advanced[i]);
+		check_term(differences, "most backward enemy pawn", position, side, eval_data.min_most_backward[i],
+				   check_data.min_most_backward[i]);
+		check_term(differences, "passed pawn", position, side, eval_data.max_passed_pawns[i],
+				   check_data.max_passed_pawns[i]);
+	}
+
+	for (i = 0; i < 2; i++)
+		check_term(differences, "pawns on a square colour", position, side, eval_data.max_pawn_color_bins[i],
+				   check_data.max_pawn_color_bins[i]);
+
+	check_term(differences, "pawns", position, side, eval_data.max_total_pawns, check_data.max_total_pawns);
+	check_term(differences, "pawn rams", position, side, eval_data.pawn_rams, check_data.pawn_rams);
+	check_term(differences, "pawn structure", position, side, eval_pawn_structure(board, &eval_data, side),
+			   check_pawn_structure(&check_data, side));
+}
+
+/* Number of random pawn sets checked by eval_check(). */
+#define CHECK_PAWN_SETS 200000
+
+int eval_check(void) {
+	eval_positions_t positions;
+	int pawn_differences = 0;
+	int differences = 0;
+	int i;
+
+	memset(&positions, 0, sizeof(positions));
+	bench_games(0, &positions);
+
+	if (!positions.count) {
+		fprintf(stderr, "Failed to allocate memory for evaluation check\n");
+		eval_positions_free(&positions);
+		return -1;
+	}
+
+	for (i = 0; i < positions.count; i++) {
+		bitboard_t pieces[NR_PIECES];
+		board_t board;
+		int piece;
+		int side;
+
+		for (piece = 0; piece < NR_PIECES; piece++)
+			pieces[piece] = positions.pieces[piece][i];
+
+		setup_board_bitboards(&board, pieces, positions.current_player[i], positions.castle_flags[i]);
+
+		for (side = SIDE_WHITE; side <= SIDE_BLACK; side++) {
+			eval_data_t eval_data;
+
+			check_pawns(&differences, &board, i, side);
+			analyze_pawn_structure(&board, &eval_data, side);
+
+			check_term(&differences, "king tropism", i, side, eval_king_tropism(&board, side),
+					   check_king_tropism(&board, side));
+			check_term(&differences, "rook bonus", i, side, eval_rook_bonus(&board, &eval_data, side),
+					   check_rook_bonus(&board, &eval_data, side));
+			check_term(&differences, "development", i, side, eval_development(&board, side),
+					   check_development(&board, side));
+			check_term(&differences, "bad bishops", i, side, eval_bad_bishops(&board, &eval_data, side),
+					   check_bad_bishops(&board, &eval_data, side));
+		}
+	}
+
+	printf("Evaluation terms: %d positions, %d differences\n", positions.count, differences);
+
+	/* Pawns placed at random on ranks 2 to 7, about six of each colour. */
+	for (i = 0; i < CHECK_PAWN_SETS; i++) {
+		bitboard_t pawns[2] = {0, 0};
+		board_t board;
+		int square;
+		int side;
+
+		for (square = 8; square <= 55; square++)
+			if (rand() % 4 == 0)
+				pawns[rand() % 2] |= square_bit[square];
+
+		memset(&board, 0, sizeof(board_t));
+		board.bitboard[WHITE_PAWN] = pawns[SIDE_WHITE];
+		board.bitboard[BLACK_PAWN] = pawns[SIDE_BLACK];
+
+		for (side = SIDE_WHITE; side <= SIDE_BLACK; side++)
+			check_pawns(&pawn_differences, &board, i, side);
+	}
+
+	printf("Pawn structure: %d random pawn sets, %d differences\n", CHECK_PAWN_SETS, pawn_differences);
+	differences += pawn_differences;
+
+	eval_positions_free(&positions);
+	return (differences ? -1 : 0);
 }
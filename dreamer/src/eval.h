@@ -34,8 +34,133 @@ typedef struct eval_data {
 	int min_most_backward[8];
 } eval_data_t;
 
+void eval_init(void);
+/* Initialises the lookup tables used by the evaluation.
+** Parameters: (void)
+** Returns   : (void)
+*/
+
+int eval_param_count(void);
+/* Retrieves the number of evaluation weights.
+** Parameters: (void)
+** Returns   : (int): The number of weights.
+*/
+
+const char *eval_param_name(int param);
+/* Retrieves the name of an evaluation weight.
+** Parameters: (int) param: The weight, 0 to eval_param_count() - 1.
+** Returns   : (const char *): The name.
+*/
+
+int eval_get_param(int param);
+/* Retrieves the value of an evaluation weight.
+** Parameters: (int) param: The weight.
+** Returns   : (int): The value.
+*/
+
+void eval_set_param(int param, int value);
+/* Changes an evaluation weight and clears the evaluation caches. Boards
+** that are already set up keep their old material totals.
+** Parameters: (int) param: The weight.
+**             (int) value: The new value.
+** Returns   : (void)
+*/
+
+void eval_clear_caches(void);
+/* Clears the pawn structure and evaluation caches of the calling thread.
+** Parameters: (void)
+** Returns   : (void)
+*/
+
+int eval_cache_init(void);
+/* Allocates the pawn structure and evaluation caches of the calling
+** thread. Threads without them evaluate every position in full.
+** Parameters: (void)
+** Returns   : (int) 0 on success, -1 if there is not enough memory.
+*/
+
+void eval_cache_exit(void);
+/* Frees the pawn structure and evaluation caches of the calling thread.
+** Parameters: (void)
+** Returns   : (void)
+*/
+
+int eval_load_params(const char *filename);
+/* Loads evaluation weights from a file with one "name value" pair per
+** line, as written by the tuner. Lines starting with '#' are ignored.
+** Parameters: (const char *) filename: Path of the file.
+** Returns   : (int): 0 on success, -1 on error.
+*/
+
+/* Positions for evaluation in bulk, stored as a structure of arrays so that
+** the set-wise terms can be computed for many positions at once. Clear it
+** with memset() before adding the first position.
+*/
+typedef struct eval_positions {
+	/* Bitboards of the pieces, indexed by piece and then by position. */
+	bitboard_t *pieces[NR_PIECES];
+
+	/* Side to move and castling flags of each position. */
+	int *current_player;
+	int *castle_flags;
+
+	/* Number of positions, and number that fit in the arrays. */
+	int count;
+	int size;
+} eval_positions_t;
+
 int board_eval_quick(board_t *board, int side);
 
 int board_eval_complete(board_t *board, int side, int alpha, int beta);
 
+int eval_positions_add(eval_positions_t *positions, const board_t *board);
+/* Adds the pieces, side to move and castling flags of a board to a set of
+** positions, growing the arrays as needed.
+** Parameters: (eval_positions_t *) positions: The set of positions.
+**             (const board_t *) board: The board.
+** Returns   : (int): 0 on success, -1 if there is not enough memory.
+*/
+
+void eval_positions_free(eval_positions_t *positions);
+/* Frees the arrays of a set of positions and empties it.
+** Parameters: (eval_positions_t *) positions: The set of positions.
+** Returns   : (void)
+*/
+
+void eval_batch(const eval_positions_t *positions, int first, int last, int *results, int threads);
+/* Evaluates a range of positions for their side to move, without using the
+** evaluation cache or lazy evaluation.
+** Parameters: (const eval_positions_t *) positions: The positions.
+**             (int) first: The first position to evaluate.
+**             (int) last: One past the last position to evaluate.
+**             (int *) results: Receives the score of each position, at
+**                 the index of the position.
+**             (int) threads: Number of threads to use, or 0 for one per
+**                 processor.
+** Returns   : (void)
+*/
+
+void eval_benchmark(void);
+/* Measures evaluation speed over positions from random games, for the
+** classic evaluation, the network if one is loaded, and batch evaluation.
+** Parameters: (void)
+** Returns   : (void)
+*/
+
+int eval_check(void);
+/* Compares the pawn structure analysis and the set-wise evaluation terms
+** with square-by-square versions of them, over positions from random games
+** and random sets of pawns, and prints the differences.
+** Parameters: (void)
+** Returns   : (int): 0 if the terms agree, -1 otherwise.
+*/
+
+void eval_cache_stats(long long *probes, long long *hits);
+/* Retrieves and resets the evaluation cache statistics.
+** Parameters: (long long *) probes: Receives the number of cache lookups.
+**             (long long *) hits: Receives the number of lookups that
+**                 were answered from the cache.
+** Returns   : (void)
+*/
+
 #endif
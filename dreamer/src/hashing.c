@@ -21,7 +21,7 @@
 #include "hashing.h"
 #include "board.h"
 
-unsigned long long random_seed_64 = 1;
+unsigned long long random_seed_64 = ZOBRIST_SEED;
 unsigned long long pieces_hash[12][64];
 unsigned long long castle_hash[4];
 unsigned long long ep_hash[64];
@@ -35,8 +35,13 @@ unsigned long long random_rand_64(void) {
 	return random_seed_64;
 }
 
+void random_init_64(unsigned long long seed) {
+	random_seed_64 = seed;
+}
+
 void init_hash(void) {
 	int i, j;
+	random_init_64(ZOBRIST_SEED);
 	for (i = 0; i < 12; i++)
 		for (j = 0; j < 64; j++)
 			pieces_hash[i][j] = random_rand_64();
@@ -49,7 +54,6 @@ void init_hash(void) {
 
 unsigned long long hash_key(board_t *board) {
 	int piece;
-	int square;
 	int i;
 	unsigned long long hash = 0;
 	bitboard_t bitboard;
@@ -63,20 +67,20 @@ unsigned long long hash_key(board_t *board) {
 			bitboard ^= BLACK_PHANTOM_KINGSIDE;
 		if ((piece == BLACK_KING) && (board->castle_flags & BLACK_PHANTOM_KINGS_QUEENSIDE))
 			bitboard ^= BLACK_PHANTOM_QUEENSIDE;
-		if (bitboard)
-			for (square = 0; square < 64; square++)
-				if (bitboard & square_bit[square])
-					hash ^= pieces_hash[piece][square];
+		while (bitboard) {
+			hash ^= pieces_hash[piece][BIT_FIRST(bitboard)];
+			bitboard &= bitboard - 1;
+		}
 	}
 	for (i = 0; i < 4; i++)
 		if (board->castle_flags & (1 << i))
 			hash ^= castle_hash[i];
 
 	bitboard = board->en_passant;
-	if (bitboard)
-		for (square = 0; square < 64; square++)
-			if (bitboard & square_bit[square])
-				hash ^= ep_hash[square];
+	while (bitboard) {
+		hash ^= ep_hash[BIT_FIRST(bitboard)];
+		bitboard &= bitboard - 1;
+	}
 
 	if (board->current_player)
 		hash ^= black_to_move;
@@ -23,6 +23,11 @@
 
 #include "board.h"
 
+/* Seed of the Zobrist key generator. Hash keys are only comparable between
+** processes that use the same seed, so it is recorded in hash table files.
+*/
+#define ZOBRIST_SEED 1
+
 extern unsigned long long random_seed_64;
 extern unsigned long long pieces_hash[12][64];
 extern unsigned long long castle_hash[4];
@@ -25,22 +25,87 @@
 #include "board.h"
 #include "history.h"
 #include "move.h"
+#include "thread.h"
 
-static int history[2][64][64];
+/* Bound of history values. Updates move a value towards the bound by a
+** fraction of the distance left, so frequent moves saturate instead of
+** overflowing and recent results outweigh old ones.
+*/
+#define HISTORY_MAX 16384
 
-static inline int move_compare(move_t move1, move_t move2, int current_side) {
+/* Added to the score of captures, which are tried before all other moves
+** whatever their history, most valuable victim first and then least
+** valuable attacker first.
+*/
+#define CAPTURE_SCORE (1 << 30)
 
-	if ((move1 & (CAPTURE_MOVE | CAPTURE_MOVE_EN_PASSANT)) && !(move2 & (CAPTURE_MOVE | CAPTURE_MOVE_EN_PASSANT)))
-		return -1;
+/* Added to the score of killer moves, which are tried after captures and
+** before the other quiet moves.
+*/
+#define KILLER_SCORE (1 << 29)
 
-	if (!(move1 & (CAPTURE_MOVE | CAPTURE_MOVE_EN_PASSANT)) && (move2 & (CAPTURE_MOVE | CAPTURE_MOVE_EN_PASSANT)))
-		return 1;
+typedef struct history_tables {
+	int history[2][64][64];
 
-	if (history[current_side][MOVE_GET(move1, SOURCE)][MOVE_GET(move1, DEST)] >
-		history[current_side][MOVE_GET(move2, SOURCE)][MOVE_GET(move2, DEST)])
-		return -1;
-	else
-		return 1;
+	/* The last two quiet moves that caused a cutoff at each ply, most
+	** recent first.
+	*/
+	move_t killers[MAX_DEPTH + 1][2];
+
+	/* History of moves by the piece and destination of the move before
+	** them.
+	*/
+	short continuation[12][64][12][64];
+} history_tables_t;
+
+/* Each searching thread learns its own history. The tables are only
+** allocated by the threads that search, see history_init().
+*/
+static THREAD_LOCAL history_tables_t *tables;
+
+static inline short *continuation_entry(move_t previous, move_t move) {
+	return &tables->continuation[MOVE_GET(previous, PIECE)][MOVE_GET(previous, DEST)][MOVE_GET(move, PIECE)]
+						[MOVE_GET(move, DEST)];
+}
+
+static inline int move_score(move_t move, int ply, move_t previous, int current_side) {
+	int score;
+
+	if (move & (CAPTURE_MOVE | CAPTURE_MOVE_EN_PASSANT))
+		return CAPTURE_SCORE + (MOVE_GET(move, CAPTURED) >> 1) * 8 - (MOVE_GET(move, PIECE) >> 1);
+
+	/* Threads that don't search walk the quiet moves in generation order. */
+	if (!tables)
+		return 0;
+
+	if (move == tables->killers[ply][0])
+		return KILLER_SCORE + 1;
+
+	if (move == tables->killers[ply][1])
+		return KILLER_SCORE;
+
+	score = tables->history[current_side][MOVE_GET(move, SOURCE)][MOVE_GET(move, DEST)];
+
+	if (previous != NO_MOVE)
+		score += *continuation_entry(previous, move);
+
+	return score;
+}
+
+static inline int gravity(int value, int bonus) {
+	return value + bonus - value * (bonus < 0 ? -bonus : bonus) / HISTORY_MAX;
+}
+
+static void update(move_t move, move_t previous, int side, int bonus) {
+	int *entry = &tables->history[side][MOVE_GET(move, SOURCE)][MOVE_GET(move, DEST)];
+
+	*entry = gravity(*entry, bonus);
+
+	if (previous != NO_MOVE) {
+		short *cont = continuation_entry(previous, move);
+
+		*cont = gravity(*cont, bonus);
+	}
 }
 
 void best_first(int ply, move_t move) {
@@ -54,29 +119,101 @@ void best_first(int ply, move_t move) {
 		}
 }
 
-void sort_next(int ply, int side) {
-	int i, min;
+void score_moves(int ply, int side) {
+	move_t previous = ply > 0 ? moves_played[ply - 1] : NO_MOVE;
+	int i;
+
+	for (i = moves_cur[ply]; i < moves_start[ply + 1]; i++)
+		move_scores[i] = move_score(moves[i], ply, previous, side);
+}
+
+void sort_next(int ply) {
+	int i, max;
 	move_t swap;
+	int swap_score;
 
-	min = moves_cur[ply];
+	max = moves_cur[ply];
 
 	for (i = moves_cur[ply] + 1; i < moves_start[ply + 1]; i++)
-		if (move_compare(moves[i], moves[min], side) < 0)
-			min = i;
+		if (move_scores[i] > move_scores[max])
+			max = i;
 
 	swap = moves[moves_cur[ply]];
-	moves[moves_cur[ply]] = moves[min];
-	moves[min] = swap;
+	moves[moves_cur[ply]] = moves[max];
+	moves[max] = swap;
+
+	swap_score = move_scores[moves_cur[ply]];
+	move_scores[moves_cur[ply]] = move_scores[max];
+	move_scores[max] = swap_score;
+}
+
+void history_cutoff(int ply, int side, int depth, move_t move, const move_t *quiets, int quiet_count) {
+	move_t previous = ply > 0 ? moves_played[ply - 1] : NO_MOVE;
+	int bonus = depth * depth;
+	int i;
+
+	if (bonus > HISTORY_MAX / 16)
+		bonus = HISTORY_MAX / 16;
+
+	if (move != tables->killers[ply][0]) {
+		tables->killers[ply][1] = tables->killers[ply][0];
+		tables->killers[ply][0] = move;
+	}
+
+	update(move, previous, side, bonus);
+
+	for (i = 0; i < quiet_count; i++)
+		update(quiets[i], previous, side, -bonus);
 }
 
-void add_count(move_t move, int side) {
-	history[side][MOVE_GET(move, SOURCE)][MOVE_GET(move, DEST)]++;
+static void clear_killers(void) {
+	int i;
+
+	for (i = 0; i <= MAX_DEPTH; i++)
+		tables->killers[i][0] = tables->killers[i][1] = NO_MOVE;
 }
 
-void forget_history(void) {
-	int i, j, k;
+void history_age(void) {
+	int i, j, k, l;
+
+	if (!tables)
+		return;
+
 	for (i = 0; i < 2; i++)
 		for (j = 0; j < 64; j++)
 			for (k = 0; k < 64; k++)
-				history[i][j][k] = 0;
+				tables->history[i][j][k] /= 2;
+
+	for (i = 0; i < 12; i++)
+		for (j = 0; j < 64; j++)
+			for (k = 0; k < 12; k++)
+				for (l = 0; l < 64; l++)
+					tables->continuation[i][j][k][l] /= 2;
+
+	/* Killers are only kept within a search. */
+	clear_killers();
+}
+
+void forget_history(void) {
+	if (!tables)
+		return;
+
+	memset(tables->history, 0, sizeof(tables->history));
+	memset(tables->continuation, 0, sizeof(tables->continuation));
+	clear_killers();
+}
+
+int history_init(void) {
+	tables = malloc(sizeof(history_tables_t));
+
+	if (!tables)
+		return -1;
+
+	forget_history();
+	return 0;
+}
+
+void history_exit(void) {
+	free(tables);
+	tables = NULL;
 }
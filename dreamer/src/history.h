@@ -25,12 +25,44 @@
 
 void sort_moves(int ply, int side, move_t best_move);
 
-void sort_next(int ply, int side);
+void score_moves(int ply, int side);
 
-void add_count(move_t move, int side);
+void sort_next(int ply);
+
+void history_cutoff(int ply, int side, int depth, move_t move, const move_t *quiets, int quiet_count);
+/* Rewards a quiet move that caused a cutoff and penalizes the quiet moves
+** tried before it. Bonuses grow with the square of the depth. The move
+** also becomes the first killer move of the ply.
+** Parameters: (int) ply: The ply of the cutoff.
+**             (int) side: The side that made the moves.
+**             (int) depth: The remaining depth of the cutoff.
+**             (move_t) move: The quiet move that caused the cutoff.
+**             (const move_t *) quiets: The quiet moves that were searched.
+**             (int) quiet_count: The number of quiet moves.
+** Returns   : (void)
+*/
+
+void history_age(void);
+/* Halves all history values, to be called between searches.
+** Parameters: (void)
+** Returns   : (void)
+*/
 
 void forget_history(void);
 
+int history_init(void);
+/* Allocates the history tables of the calling thread, which must be done
+** before it orders moves with them.
+** Parameters: (void)
+** Returns   : (int) 0 on success, -1 if there is not enough memory.
+*/
+
+void history_exit(void);
+/* Frees the history tables of the calling thread.
+** Parameters: (void)
+** Returns   : (void)
+*/
+
 void best_first(int ply, move_t move);
 
 #endif
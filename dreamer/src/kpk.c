@@ -0,0 +1,253 @@
+/*  DreamChess
+**
+**  DreamChess is the legal property of its developers, whose names are too
+**  numerous to list here. Please refer to the AUTHORS.txt file distributed
+**  with this source distribution.
+**
+**  This program is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "board.h"
+#include "kpk.h"
+#include "tb.h"
+
+/* Number of positions: side to move, two king squares, and 24 pawn
+** squares.
+*/
+#define KPK_POSITIONS (2 * 64 * 64 * 24)
+
+/* Classification of positions during generation. */
+#define KPK_INVALID 0
+#define KPK_UNKNOWN 1
+#define KPK_DRAW 2
+#define KPK_WIN 4
+
+static unsigned char bitbase[KPK_POSITIONS / 8];
+
+static int kpk_index(int side, int black_king, int white_king, int pawn) {
+	/* The pawn is on files A to D and ranks 2 to 7. */
+	return side + (black_king << 1) + (white_king << 7) + ((pawn & 7) << 13) + ((6 - (pawn >> 3)) << 15);
+}
+
+static int distance(int square1, int square2) {
+	int rank_distance = abs((square1 >> 3) - (square2 >> 3));
+	int file_distance = abs((square1 & 7) - (square2 & 7));
+
+	return rank_distance > file_distance ? rank_distance : file_distance;
+}
+
+static int index_pawn(int index) {
+	return ((index >> 13) & 3) + ((6 - (index >> 15)) << 3);
+}
+
+static int pawn_attacks(int pawn, int square) {
+	return ((pawn & 7) != 0 && square == pawn + 7) || ((pawn & 7) != 7 && square == pawn + 9);
+}
+
+static int slider_attacks(int slider, int diagonals, int square, int blocker) {
+	/* Whether a queen, or a rook if diagonals is 0, attacks a square, with
+	** one piece that may block.
+	*/
+	int rank_step = ((square >> 3) > (slider >> 3)) - ((square >> 3) < (slider >> 3));
+	int file_step = ((square & 7) > (slider & 7)) - ((square & 7) < (slider & 7));
+	int rank_distance = abs((square >> 3) - (slider >> 3));
+	int file_distance = abs((square & 7) - (slider & 7));
+	int i;
+
+	if (slider == square || (rank_distance && file_distance && (!diagonals || rank_distance != file_distance)))
+		return 0;
+
+	for (i = slider + rank_step * 8 + file_step; i != square; i += rank_step * 8 + file_step)
+		if (i == blocker)
+			return 0;
+
+	return 1;
+}
+
+static int promotion_stalemates(int white_king, int promotion, int black_king, int diagonals) {
+	int square;
+
+	if (slider_attacks(promotion, diagonals, black_king, white_king))
+		return 0;
+
+	for (square = 0; square < 64; square++)
+		if (distance(black_king, square) == 1 && distance(white_king, square) > 1 &&
+			!slider_attacks(promotion, diagonals, square, white_king))
+			return 0;
+
+	return 1;
+}
+
+static int classify_initial(int side, int black_king, int white_king, int pawn) {
+	int queening = pawn + 8;
+
+	if (distance(white_king, black_king) <= 1 || white_king == pawn || black_king == pawn)
+		return KPK_INVALID;
+
+	if (side == SIDE_WHITE) {
+		/* Black can't be in check with white to move. */
+		if (pawn_attacks(pawn, black_king))
+			return KPK_INVALID;
+
+		/* The pawn promotes safely. Where a queen stalemates, a rook may
+		** still win; promoting to a minor piece never wins.
+		*/
+		if ((pawn >> 3) == 6 && white_king != queening && black_king != queening &&
+			(distance(black_king, queening) > 1 || distance(white_king, queening) == 1) &&
+			(!promotion_stalemates(white_king, queening, black_king, 1) ||
+			 !promotion_stalemates(white_king, queening, black_king, 0)))
+			return KPK_WIN;
+	} else {
+		int moves = 0;
+		int square;
+
+		for (square = 0; square < 64; square++)
+			if (distance(black_king, square) == 1 && distance(white_king, square) > 1 &&
+				!pawn_attacks(pawn, square))
+				moves++;
+
+		/* Stalemate. */
+		if (moves == 0)
+			return KPK_DRAW;
+
+		/* Black captures the pawn. */
+		if (distance(black_king, pawn) == 1 && distance(white_king, pawn) > 1)
+			return KPK_DRAW;
+	}
+
+	return KPK_UNKNOWN;
+}
+
+static int classify(unsigned char *db, int side, int black_king, int white_king, int pawn) {
+	/* Combines the classifications of the positions after each move. With
+	** white to move one winning move wins, with black to move one drawing
+	** move draws. Moves to invalid positions are illegal and skipped.
+	*/
+	int good = side == SIDE_WHITE ? KPK_WIN : KPK_DRAW;
+	int bad = side == SIDE_WHITE ? KPK_DRAW : KPK_WIN;
+	int result = 0;
+	int square;
+
+	for (square = 0; square < 64; square++) {
+		if (side == SIDE_WHITE && distance(white_king, square) == 1)
+			result |= db[kpk_index(SIDE_BLACK, black_king, square, pawn)];
+		else if (side == SIDE_BLACK && distance(black_king, square) == 1)
+			result |= db[kpk_index(SIDE_WHITE, square, white_king, pawn)];
+	}
+
+	if (side == SIDE_WHITE && (pawn >> 3) < 6) {
+		int push = pawn + 8;
+
+		if (push != white_king && push != black_king) {
+			result |= db[kpk_index(SIDE_BLACK, black_king, white_king, push)];
+
+			/* Double push from the second rank. */
+			if ((pawn >> 3) == 1 && push + 8 != white_king && push + 8 != black_king)
+				result |= db[kpk_index(SIDE_BLACK, black_king, white_king, push + 8)];
+		}
+	}
+
+	if (result & good)
+		return good;
+	if (result & KPK_UNKNOWN)
+		return KPK_UNKNOWN;
+	return bad;
+}
+
+void kpk_init(void) {
+	unsigned char *db = malloc(KPK_POSITIONS);
+	int changed = 1;
+	int i;
+
+	if (!db)
+		exit(1);
+
+	for (i = 0; i < KPK_POSITIONS; i++)
+		db[i] = classify_initial(i & 1, (i >> 1) & 63, (i >> 7) & 63, index_pawn(i));
+
+	while (changed) {
+		changed = 0;
+
+		for (i = 0; i < KPK_POSITIONS; i++)
+			if (db[i] == KPK_UNKNOWN) {
+				db[i] = classify(db, i & 1, (i >> 1) & 63, (i >> 7) & 63, index_pawn(i));
+				if (db[i] != KPK_UNKNOWN)
+					changed = 1;
+			}
+	}
+
+	/* Positions that remain unknown can't be won. */
+	memset(bitbase, 0, sizeof(bitbase));
+
+	for (i = 0; i < KPK_POSITIONS; i++)
+		if (db[i] == KPK_WIN)
+			bitbase[i >> 3] |= 1 << (i & 7);
+
+	free(db);
+}
+
+int kpk_probe(int white_king, int white_pawn, int black_king, int side) {
+	int index;
+
+	if ((white_pawn & 7) > 3) {
+		white_king ^= 7;
+		white_pawn ^= 7;
+		black_king ^= 7;
+	}
+
+	index = kpk_index(side, black_king, white_king, white_pawn);
+
+	return (bitbase[index >> 3] >> (index & 7)) & 1;
+}
+
+int kpk_check(void) {
+	int pieces[3] = {WHITE_KING, WHITE_PAWN, BLACK_KING};
+	int differences = 0;
+	int positions = 0;
+	int squares[3];
+	int side;
+
+	for (side = SIDE_WHITE; side <= SIDE_BLACK; side++)
+		for (squares[0] = 0; squares[0] < 64; squares[0]++)
+			for (squares[1] = 8; squares[1] < 56; squares[1]++)
+				for (squares[2] = 0; squares[2] < 64; squares[2]++) {
+					int wdl;
+
+					if (distance(squares[0], squares[2]) <= 1 || squares[1] == squares[0] ||
+						squares[1] == squares[2] || (side == SIDE_WHITE && pawn_attacks(squares[1], squares[2])))
+						continue;
+
+					wdl = tb_probe_pieces(3, pieces, squares, side, NULL);
+
+					if (wdl < 0) {
+						printf("No KPvK table loaded\n");
+						return -1;
+					}
+
+					positions++;
+
+					if ((wdl != TB_DRAW) != kpk_probe(squares[0], squares[1], squares[2], side)) {
+						if (++differences <= 20)
+							printf("KPK bitbase differs: white king %d, pawn %d, black king %d, %s to move\n",
+								   squares[0], squares[1], squares[2], (side == SIDE_WHITE ? "white" : "black"));
+					}
+				}
+
+	printf("KPK bitbase: %d positions, %d differences\n", positions, differences);
+	return (differences ? -1 : 0);
+}
@@ -0,0 +1,55 @@
+/*  DreamChess
+**
+**  DreamChess is the legal property of its developers, whose names are too
+**  numerous to list here. Please refer to the AUTHORS.txt file distributed
+**  with this source distribution.
+**
+**  This program is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef DREAMER_KPK_H
+#define DREAMER_KPK_H
+
+/* King and pawn versus king bitbase.
+**
+** Holds one bit per position with white to move or black to move, the white
+** pawn on files A to D and ranks 2 to 7, and any king squares, telling
+** whether white wins. Positions with the pawn on files E to H are mirrored.
+** The bitbase takes 24 KB and is computed by retrograde analysis.
+*/
+
+void kpk_init(void);
+/* Computes the bitbase.
+** Parameters: (void)
+** Returns   : (void)
+*/
+
+int kpk_probe(int white_king, int white_pawn, int black_king, int side);
+/* Looks up a position with a white pawn in the bitbase.
+** Parameters: (int) white_king: Square of the white king.
+**             (int) white_pawn: Square of the white pawn, on rank 2 to 7.
+**             (int) black_king: Square of the black king.
+**             (int) side: The side to move.
+** Returns   : (int): 1 if white wins, 0 if it's a draw.
+*/
+
+int kpk_check(void);
+/* Compares the bitbase with the KPvK endgame table over all legal
+** positions, and prints the differences.
+** Parameters: (void)
+** Returns   : (int): 0 if they agree, -1 if they differ or there is no
+**                 KPvK table.
+*/
+
+#endif
@@ -19,22 +19,250 @@
 */
 
 #include <stdio.h>
+#include <stdlib.h>
+
+#include "config.h"
+
+#ifdef HAVE_GETOPT_H
+#include <getopt.h>
+#else
+#include <unistd.h>
+#endif
 
 #include "board.h"
+#include "dreamer.h"
+#include "endgame.h"
+#include "eval.h"
 #include "git_rev.h"
 #include "hashing.h"
+#include "kpk.h"
 #include "move.h"
+#include "nnue.h"
+#include "search.h"
+#include "tb.h"
 #include "transposition.h"
+#include "tune.h"
+
+#ifdef HAVE_GETOPT_LONG
+#define OPTION_TEXT(L, S) "  " L "\t  " S "\t%s\n"
+#else
+#define OPTION_TEXT(L, S) "  " S "\t%s\n"
+#endif
+
+typedef struct cl_options {
+	int hash_size;
+	char *hash_file;
+	char *hash_shm;
+	int prune_depth;
+	char *nnue_file;
+	int bench_eval;
+	char *params_file;
+	char *tune_file;
+	char *tb_path;
+	char *gen_tb;
+	int move_overhead;
+	int ponder_moves;
+	int check;
+} cl_options_t;
 
 int engine(void *data);
 
+static void parse_options(int argc, char **argv, cl_options_t *cl_options) {
+	int c;
+
+#ifdef HAVE_GETOPT_LONG
+
+	int optindex;
+
+	struct option options[] = {{"help", no_argument, NULL, 'h'},
+							   {"hash", required_argument, NULL, 'm'},
+							   {"hash-file", required_argument, NULL, 'f'},
+							   {"hash-shm", required_argument, NULL, 's'},
+							   {"prune-hash", required_argument, NULL, 'c'},
+							   {"nnue", required_argument, NULL, 'n'},
+							   {"bench-eval", no_argument, NULL, 'b'},
+							   {"params", required_argument, NULL, 'p'},
+							   {"tune", required_argument, NULL, 't'},
+							   {"tb-path", required_argument, NULL, 'e'},
+							   {"gen-tb", required_argument, NULL, 'g'},
+							   {"move-overhead", required_argument, NULL, 'o'},
+							   {"ponder-moves", required_argument, NULL, 'k'},
+							   {"check", no_argument, NULL, 'x'},
+							   {0, 0, 0, 0}};
+
+	while ((c = getopt_long(argc, argv, "bc:e:f:g:hk:m:n:o:p:s:t:x", options, &optindex)) > -1) {
+#else
+
+	while ((c = getopt(argc, argv, "bc:e:f:g:hk:m:n:o:p:s:t:x")) > -1) {
+#endif /* HAVE_GETOPT_LONG */
+		switch (c) {
+		case 'h':
+			printf("Usage: dreamer [options]\n\n"
+				   "An xboard-compatible chess engine.\n\n"
+				   "Options:\n");
+			printf(OPTION_TEXT("--help\t\t", "-h\t"), "show help");
+			printf(OPTION_TEXT("--hash <mb>\t", "-m<mb>\t"), "set hash table size");
+			printf(OPTION_TEXT("--hash-file <file>", "-f<file>"), "keep hash table in <file>");
+			printf(OPTION_TEXT("--hash-shm <name>", "-s<name>"), "share hash table with other processes");
+			printf(OPTION_TEXT("--prune-hash <d>", "-c<d>\t"), "drop entries below depth <d> from");
+			printf(OPTION_TEXT("\t\t", "\t"), "  the hash table file and exit");
+			printf(OPTION_TEXT("--nnue <file>\t", "-n<file>"), "evaluate with the network in <file>");
+			printf(OPTION_TEXT("--bench-eval\t", "-b\t"), "measure evaluation speed and exit");
+			printf(OPTION_TEXT("--params <file>", "-p<file>"), "load evaluation weights from <file>");
+			printf(OPTION_TEXT("--tune <file>\t", "-t<file>"), "tune evaluation weights to the positions");
+			printf(OPTION_TEXT("\t\t", "\t"), "  in <file>, print them and exit");
+			printf(OPTION_TEXT("--tb-path <dir>", "-e<dir>"), "probe endgame tables in <dir>");
+			printf(OPTION_TEXT("--gen-tb <set>\t", "-g<set>"), "generate the endgame tables for <set>,");
+			printf(OPTION_TEXT("\t\t", "\t"), "  or for up to <set> pieces, and exit");
+			printf(OPTION_TEXT("--move-overhead <ms>", "-o<ms>\t"), "reserve <ms> per move for communication");
+			printf(OPTION_TEXT("--ponder-moves <n>", "-k<n>\t"), "ponder on the <n> likeliest replies");
+			printf(OPTION_TEXT("--check\t", "-x\t"), "check the evaluation against reference");
+			printf(OPTION_TEXT("\t\t", "\t"), "  versions of its terms, and the KPK");
+			printf(OPTION_TEXT("\t\t", "\t"), "  bitbase against the tables, and exit");
+			exit(0);
+		case 'm':
+			cl_options->hash_size = atoi(optarg);
+			break;
+		case 'f':
+			cl_options->hash_file = optarg;
+			break;
+		case 's':
+			cl_options->hash_shm = optarg;
+			break;
+		case 'c':
+			cl_options->prune_depth = atoi(optarg);
+			break;
+		case 'n':
+			cl_options->nnue_file = optarg;
+			break;
+		case 'b':
+			cl_options->bench_eval = 1;
+			break;
+		case 'p':
+			cl_options->params_file = optarg;
+			break;
+		case 't':
+			cl_options->tune_file = optarg;
+			break;
+		case 'e':
+			cl_options->tb_path = optarg;
+			break;
+		case 'g':
+			cl_options->gen_tb = optarg;
+			break;
+		case 'o':
+			cl_options->move_overhead = atoi(optarg);
+			break;
+		case 'k':
+			cl_options->ponder_moves = atoi(optarg);
+			break;
+		case 'x':
+			cl_options->check = 1;
+			break;
+		default:
+			exit(1);
+		}
+	}
+}
+
 int main(int argc, char **argv) {
+	cl_options_t cl_options = {128, NULL, NULL, -1, NULL, 0, NULL, NULL, NULL, NULL, 30, 1, 0};
+
 	fprintf(stderr, "Dreamer %s\n", g_version);
 
+	parse_options(argc, argv, &cl_options);
+
+	if (cl_options.hash_size <= 0) {
+		fprintf(stderr, "Invalid hash table size\n");
+		return 1;
+	}
+
+	if (cl_options.move_overhead < 0) {
+		fprintf(stderr, "Invalid move overhead\n");
+		return 1;
+	}
+
+	if (cl_options.ponder_moves < 1 || cl_options.ponder_moves > PONDER_MAX_MOVES) {
+		fprintf(stderr, "Invalid number of ponder moves\n");
+		return 1;
+	}
+
+	if (cl_options.tune_file && cl_options.nnue_file) {
+		fprintf(stderr, "--tune cannot be combined with --nnue\n");
+		return 1;
+	}
+
+	if (cl_options.hash_file && cl_options.hash_shm) {
+		fprintf(stderr, "--hash-file and --hash-shm cannot be combined\n");
+		return 1;
+	}
+
 	board_init();
 	init_hash();
 	move_init();
-	transposition_init(128);
+	eval_init();
+	endgame_init();
+	nnue_init();
+
+	if (cl_options.params_file && eval_load_params(cl_options.params_file))
+		return 1;
+
+	if (cl_options.tune_file)
+		return tune(cl_options.tune_file) ? 1 : 0;
+
+	if (cl_options.gen_tb) {
+		int retval = tb_generate(cl_options.tb_path ? cl_options.tb_path : ".", cl_options.gen_tb);
+
+		tb_exit();
+		return retval ? 1 : 0;
+	}
+
+	if (cl_options.tb_path)
+		fprintf(stderr, "Loaded %i endgame tables from '%s'\n", tb_init(cl_options.tb_path), cl_options.tb_path);
+
+	if (cl_options.check) {
+		int retval = eval_check();
+
+		/* The bitbase is checked against the tables when they are given. */
+		if (cl_options.tb_path && kpk_check())
+			retval = -1;
+
+		tb_exit();
+		return retval ? 1 : 0;
+	}
+
+	if (cl_options.nnue_file) {
+		if (nnue_load(cl_options.nnue_file))
+			return 1;
+		fprintf(stderr, "Using network '%s' (%s)\n", cl_options.nnue_file, nnue_kernels());
+	}
+
+	if (cl_options.bench_eval) {
+		eval_benchmark();
+		nnue_exit();
+		return 0;
+	}
+
+	if (cl_options.hash_file) {
+		if (transposition_init_file(cl_options.hash_file, cl_options.hash_size))
+			return 1;
+	} else if (cl_options.prune_depth >= 0) {
+		fprintf(stderr, "--prune-hash requires a hash table file\n");
+		return 1;
+	} else if (cl_options.hash_shm) {
+		if (transposition_init_shm(cl_options.hash_shm, cl_options.hash_size))
+			return 1;
+	} else
+		transposition_init(cl_options.hash_size);
+
+	if (cl_options.prune_depth >= 0) {
+		transposition_prune(cl_options.prune_depth);
+		transposition_exit();
+		return 0;
+	}
+
+	set_move_overhead(cl_options.move_overhead);
+	set_ponder_moves(cl_options.ponder_moves);
 
 	/* return makebook("/home/walter/tmp/GM2001.pgn", "/home/walter/tmp/opening.dcb"); */
 
@@ -39,10 +39,12 @@ int **king_moves;
 int **white_pawn_capture_moves;
 int **black_pawn_capture_moves;
 
-/* Global move list. Add 1 for in_check function */
-move_t moves[(MAX_DEPTH + 1) * 256];
-int moves_start[MAX_DEPTH + 2];
-int moves_cur[MAX_DEPTH + 1];
+/* Move list of the search in this thread. Add 1 for in_check function */
+THREAD_LOCAL move_t moves[(MAX_DEPTH + 1) * 256];
+THREAD_LOCAL int move_scores[(MAX_DEPTH + 1) * 256];
+THREAD_LOCAL int moves_start[MAX_DEPTH + 2];
+THREAD_LOCAL int moves_cur[MAX_DEPTH + 1];
+THREAD_LOCAL move_t moves_played[MAX_DEPTH + 1];
 
 #define add_moves_ray(FUNCNAME, MOVES, PIECE, PLAYER, OPPONENT_FIND, LOOP)                                             \
 	static move_t *FUNCNAME(board_t *board, move_t *move) {                                                            \
@@ -315,10 +317,16 @@ move_t move_next(board_t *board, int ply) {
 
 		if (move != NO_MOVE)
 			best_first(ply, move);
-	} else
-		sort_next(ply, board->current_player);
+	} else {
+		/* Moves are scored once, after the hash move has been tried. */
+		if (moves_cur[ply] == moves_start[ply] + 1)
+			score_moves(ply, board->current_player);
+
+		sort_next(ply);
+	}
 
-	return moves[moves_cur[ply]++];
+	moves_played[ply] = moves[moves_cur[ply]++];
+	return moves_played[ply];
 }
 
 #if 0
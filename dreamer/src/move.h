@@ -23,6 +23,7 @@
 
 #include "board.h"
 #include "dreamer.h"
+#include "thread.h"
 
 #define NORMAL_MOVE 0
 #define CAPTURE_MOVE 1
@@ -61,9 +62,14 @@
 
 #define MOVE_IS_REGULAR(M) (((M) != NO_MOVE) && ((M) != RESIGN_MOVE) && ((M) != STALEMATE_MOVE))
 
-extern move_t moves[(MAX_DEPTH + 1) * 256];
-extern int moves_start[MAX_DEPTH + 2];
-extern int moves_cur[MAX_DEPTH + 1];
+/* The move lists are per thread, so that several threads can search. */
+extern THREAD_LOCAL move_t moves[(MAX_DEPTH + 1) * 256];
+/* Ordering score of each move in moves[], higher is searched first. */
+extern THREAD_LOCAL int move_scores[(MAX_DEPTH + 1) * 256];
+extern THREAD_LOCAL int moves_start[MAX_DEPTH + 2];
+extern THREAD_LOCAL int moves_cur[MAX_DEPTH + 1];
+/* Last move returned by move_next() at each ply. */
+extern THREAD_LOCAL move_t moves_played[MAX_DEPTH + 1];
 
 void move_init(void);
 
@@ -0,0 +1,497 @@
+/*  DreamChess
+**
+**  DreamChess is the legal property of its developers, whose names are too
+**  numerous to list here. Please refer to the AUTHORS.txt file distributed
+**  with this source distribution.
+**
+**  This program is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "board.h"
+#include "nnue.h"
+
+/* x86 kernels are compiled with function attributes and picked at runtime,
+** so the rest of the engine doesn't need to be built for a newer CPU.
+*/
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define NNUE_X86
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define NNUE_NEON
+#include <arm_neon.h>
+#endif
+
+#define NNUE_FILE_VERSION 1
+
+int nnue_enabled;
+
+/* Accumulator weights, indexed by input and then by accumulator value. */
+static short *input_weights;
+static short input_biases[NNUE_HALF_DIMS];
+
+static int hidden1_biases[NNUE_HIDDEN_DIMS];
+static signed char hidden1_weights[NNUE_HIDDEN_DIMS * 2 * NNUE_HALF_DIMS];
+static int hidden2_biases[NNUE_HIDDEN_DIMS];
+static signed char hidden2_weights[NNUE_HIDDEN_DIMS * NNUE_HIDDEN_DIMS];
+static int output_bias;
+static signed char output_weights[NNUE_HIDDEN_DIMS];
+
+/* Kernels. The number of inputs of a dense layer must be a multiple of 32. */
+static void (*accumulator_add)(short *values, const short *weights);
+static void (*accumulator_sub)(short *values, const short *weights);
+static void (*dense)(const unsigned char *input, int inputs, const signed char *weights, const int *biases,
+					 int *output, int outputs);
+static const char *kernels;
+
+static void accumulator_add_scalar(short *values, const short *weights) {
+	int i;
+
+	for (i = 0; i < NNUE_HALF_DIMS; i++)
+		values[i] += weights[i];
+}
+
+static void accumulator_sub_scalar(short *values, const short *weights) {
+	int i;
+
+	for (i = 0; i < NNUE_HALF_DIMS; i++)
+		values[i] -= weights[i];
+}
+
+static void dense_scalar(const unsigned char *input, int inputs, const signed char *weights, const int *biases,
+						 int *output, int outputs) {
+	int i, j;
+
+	for (i = 0; i < outputs; i++) {
+		int sum = biases[i];
+
+		for (j = 0; j < inputs; j++)
+			sum += input[j] * weights[i * inputs + j];
+
+		output[i] = sum;
+	}
+}
+
+#ifdef NNUE_X86
+
+__attribute__((target("avx2"))) static void accumulator_add_avx2(short *values, const short *weights) {
+	int i;
+
+	for (i = 0; i < NNUE_HALF_DIMS; i += 16) {
+		__m256i v = _mm256_loadu_si256((const __m256i *)(values + i));
+		__m256i w = _mm256_loadu_si256((const __m256i *)(weights + i));
+		_mm256_storeu_si256((__m256i *)(values + i), _mm256_add_epi16(v, w));
+	}
+}
+
+__attribute__((target("avx2"))) static void accumulator_sub_avx2(short *values, const short *weights) {
+	int i;
+
+	for (i = 0; i < NNUE_HALF_DIMS; i += 16) {
+		__m256i v = _mm256_loadu_si256((const __m256i *)(values + i));
+		__m256i w = _mm256_loadu_si256((const __m256i *)(weights + i));
+		_mm256_storeu_si256((__m256i *)(values + i), _mm256_sub_epi16(v, w));
+	}
+}
+
+__attribute__((target("avx2"))) static void dense_avx2(const unsigned char *input, int inputs,
+													   const signed char *weights, const int *biases, int *output,
+													   int outputs) {
+	const __m256i ones = _mm256_set1_epi16(1);
+	int i, j;
+
+	for (i = 0; i < outputs; i++) {
+		const signed char *row = weights + i * inputs;
+		__m256i sum = _mm256_setzero_si256();
+		__m128i sum128;
+
+		for (j = 0; j < inputs; j += 32) {
+			__m256i x = _mm256_loadu_si256((const __m256i *)(input + j));
+			__m256i w = _mm256_loadu_si256((const __m256i *)(row + j));
+			/* Inputs are at most 127 and weights at least -127, so the
+			** pairwise 16-bit sums can't saturate.
+			*/
+			sum = _mm256_add_epi32(sum, _mm256_madd_epi16(_mm256_maddubs_epi16(x, w), ones));
+		}
+
+		sum128 = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+		sum128 = _mm_add_epi32(sum128, _mm_shuffle_epi32(sum128, 0x4e));
+		sum128 = _mm_add_epi32(sum128, _mm_shuffle_epi32(sum128, 0xb1));
+		output[i] = biases[i] + _mm_cvtsi128_si32(sum128);
+	}
+}
+
+__attribute__((target("sse4.1"))) static void accumulator_add_sse41(short *values, const short *weights) {
+	int i;
+
+	for (i = 0; i < NNUE_HALF_DIMS; i += 8) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(values + i));
+		__m128i w = _mm_loadu_si128((const __m128i *)(weights + i));
+		_mm_storeu_si128((__m128i *)(values + i), _mm_add_epi16(v, w));
+	}
+}
+
+__attribute__((target("sse4.1"))) static void accumulator_sub_sse41(short *values, const short *weights) {
+	int i;
+
+	for (i = 0; i < NNUE_HALF_DIMS; i += 8) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(values + i));
+		__m128i w = _mm_loadu_si128((const __m128i *)(weights + i));
+		_mm_storeu_si128((__m128i *)(values + i), _mm_sub_epi16(v, w));
+	}
+}
+
+__attribute__((target("sse4.1"))) static void dense_sse41(const unsigned char *input, int inputs,
+														  const signed char *weights, const int *biases, int *output,
+														  int outputs) {
+	const __m128i ones = _mm_set1_epi16(1);
+	int i, j;
+
+	for (i = 0; i < outputs; i++) {
+		const signed char *row = weights + i * inputs;
+		__m128i sum = _mm_setzero_si128();
+
+		for (j = 0; j < inputs; j += 16) {
+			__m128i x = _mm_loadu_si128((const __m128i *)(input + j));
+			__m128i w = _mm_loadu_si128((const __m128i *)(row + j));
+			sum = _mm_add_epi32(sum, _mm_madd_epi16(_mm_maddubs_epi16(x, w), ones));
+		}
+
+		sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4e));
+		sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xb1));
+		output[i] = biases[i] + _mm_cvtsi128_si32(sum);
+	}
+}
+
+#endif /* NNUE_X86 */
+
+#ifdef NNUE_NEON
+
+static void accumulator_add_neon(short *values, const short *weights) {
+	int i;
+
+	for (i = 0; i < NNUE_HALF_DIMS; i += 8)
+		vst1q_s16(values + i, vaddq_s16(vld1q_s16(values + i), vld1q_s16(weights + i)));
+}
+
+static void accumulator_sub_neon(short *values, const short *weights) {
+	int i;
+
+	for (i = 0; i < NNUE_HALF_DIMS; i += 8)
+		vst1q_s16(values + i, vsubq_s16(vld1q_s16(values + i), vld1q_s16(weights + i)));
+}
+
+static void dense_neon(const unsigned char *input, int inputs, const signed char *weights, const int *biases,
+					   int *output, int outputs) {
+	int i, j;
+
+	for (i = 0; i < outputs; i++) {
+		const signed char *row = weights + i * inputs;
+		int32x4_t sum = vdupq_n_s32(0);
+
+		for (j = 0; j < inputs; j += 16) {
+			/* Inputs are at most 127, so they can be treated as signed. */
+			int8x16_t x = vreinterpretq_s8_u8(vld1q_u8(input + j));
+			int8x16_t w = vld1q_s8(row + j);
+			int16x8_t product = vmull_s8(vget_low_s8(x), vget_low_s8(w));
+
+			product = vmlal_s8(product, vget_high_s8(x), vget_high_s8(w));
+			sum = vpadalq_s16(sum, product);
+		}
+
+		output[i] = biases[i] + vaddvq_s32(sum);
+	}
+}
+
+#endif /* NNUE_NEON */
+
+void nnue_init(void) {
+	accumulator_add = accumulator_add_scalar;
+	accumulator_sub = accumulator_sub_scalar;
+	dense = dense_scalar;
+	kernels = "scalar";
+
+#ifdef NNUE_X86
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("avx2")) {
+		accumulator_add = accumulator_add_avx2;
+		accumulator_sub = accumulator_sub_avx2;
+		dense = dense_avx2;
+		kernels = "AVX2";
+	} else if (__builtin_cpu_supports("sse4.1")) {
+		accumulator_add = accumulator_add_sse41;
+		accumulator_sub = accumulator_sub_sse41;
+		dense = dense_sse41;
+		kernels = "SSE4.1";
+	}
+#elif defined(NNUE_NEON)
+	accumulator_add = accumulator_add_neon;
+	accumulator_sub = accumulator_sub_neon;
+	dense = dense_neon;
+	kernels = "NEON";
+#endif
+}
+
+const char *nnue_kernels(void) {
+	return kernels;
+}
+
+static int read_uint32(FILE *f, unsigned int *value) {
+	unsigned char buf[4];
+
+	if (fread(buf, 4, 1, f) != 1)
+		return -1;
+
+	*value = buf[0] | (buf[1] << 8) | (buf[2] << 16) | ((unsigned int)buf[3] << 24);
+	return 0;
+}
+
+static int read_int32s(FILE *f, int *values, int count) {
+	int i;
+
+	for (i = 0; i < count; i++) {
+		unsigned int value;
+
+		if (read_uint32(f, &value))
+			return -1;
+
+		values[i] = (int)value;
+	}
+
+	return 0;
+}
+
+static int read_int16s(FILE *f, short *values, long count) {
+	unsigned char buf[4096];
+
+	while (count > 0) {
+		int n = (count < 2048 ? count : 2048);
+		int i;
+
+		if (fread(buf, 2, n, f) != (size_t)n)
+			return -1;
+
+		for (i = 0; i < n; i++)
+			*values++ = (short)(buf[i * 2] | (buf[i * 2 + 1] << 8));
+
+		count -= n;
+	}
+
+	return 0;
+}
+
+static int read_int8s(FILE *f, signed char *values, int count) {
+	int i;
+
+	if (fread(values, 1, count, f) != (size_t)count)
+		return -1;
+
+	for (i = 0; i < count; i++)
+		if (values[i] == -128)
+			return -1;
+
+	return 0;
+}
+
+int nnue_load(const char *filename) {
+	FILE *f;
+	char magic[4];
+	unsigned int version, inputs, half_dims, hidden_dims;
+
+	/* A failed load leaves no network, as the weights may be overwritten in
+	** part.
+	*/
+	nnue_exit();
+
+	f = fopen(filename, "rb");
+
+	if (!f) {
+		fprintf(stderr, "Failed to open network file '%s'\n", filename);
+		return -1;
+	}
+
+	if (fread(magic, 4, 1, f) != 1 || memcmp(magic, "DNN1", 4) || read_uint32(f, &version) ||
+		read_uint32(f, &inputs) || read_uint32(f, &half_dims) || read_uint32(f, &hidden_dims)) {
+		fprintf(stderr, "'%s' is not a network file\n", filename);
+		fclose(f);
+		return -1;
+	}
+
+	if (version != NNUE_FILE_VERSION || inputs != NNUE_INPUTS || half_dims != NNUE_HALF_DIMS ||
+		hidden_dims != NNUE_HIDDEN_DIMS) {
+		fprintf(stderr, "Network file '%s' has an unsupported version or layout\n", filename);
+		fclose(f);
+		return -1;
+	}
+
+	input_weights = malloc(sizeof(short) * (size_t)NNUE_INPUTS * NNUE_HALF_DIMS);
+
+	if (!input_weights) {
+		fprintf(stderr, "Failed to allocate memory for network\n");
+		fclose(f);
+		return -1;
+	}
+
+	if (read_int16s(f, input_biases, NNUE_HALF_DIMS) ||
+		read_int16s(f, input_weights, (long)NNUE_INPUTS * NNUE_HALF_DIMS) ||
+		read_int32s(f, hidden1_biases, NNUE_HIDDEN_DIMS) ||
+		read_int8s(f, hidden1_weights, NNUE_HIDDEN_DIMS * 2 * NNUE_HALF_DIMS) ||
+		read_int32s(f, hidden2_biases, NNUE_HIDDEN_DIMS) ||
+		read_int8s(f, hidden2_weights, NNUE_HIDDEN_DIMS * NNUE_HIDDEN_DIMS) || read_int32s(f, &output_bias, 1) ||
+		read_int8s(f, output_weights, NNUE_HIDDEN_DIMS)) {
+		fprintf(stderr, "Network file '%s' is truncated or corrupt\n", filename);
+		fclose(f);
+		nnue_exit();
+		return -1;
+	}
+
+	fclose(f);
+	nnue_enabled = 1;
+	return 0;
+}
+
+void nnue_exit(void) {
+	nnue_enabled = 0;
+	free(input_weights);
+	input_weights = NULL;
+}
+
+int nnue_loaded(void) {
+	return input_weights != NULL;
+}
+
+int nnue_enable(int enable) {
+	if (enable && !input_weights)
+		return -1;
+
+	nnue_enabled = enable;
+	return 0;
+}
+
+static const short *input_column(int side, int king_square, int piece, int square) {
+	int input;
+
+	if (side == SIDE_BLACK) {
+		king_square ^= 56;
+		square ^= 56;
+	}
+
+	input = king_square * 640 + ((piece & PIECE_MASK) + ((piece & 1) != side)) * 64 + square;
+	return input_weights + (size_t)input * NNUE_HALF_DIMS;
+}
+
+static void refresh_accumulator(board_t *board, int side) {
+	nnue_accumulator_t *acc = &board->accumulator;
+	bitboard_t kings = board->bitboard[KING + side];
+	int piece;
+
+	/* Phantom kings are not part of the position. */
+	if (side == SIDE_WHITE) {
+		if (board->castle_flags & WHITE_PHANTOM_KINGS_KINGSIDE)
+			kings &= ~WHITE_PHANTOM_KINGSIDE;
+		else if (board->castle_flags & WHITE_PHANTOM_KINGS_QUEENSIDE)
+			kings &= ~WHITE_PHANTOM_QUEENSIDE;
+	} else {
+		if (board->castle_flags & BLACK_PHANTOM_KINGS_KINGSIDE)
+			kings &= ~BLACK_PHANTOM_KINGSIDE;
+		else if (board->castle_flags & BLACK_PHANTOM_KINGS_QUEENSIDE)
+			kings &= ~BLACK_PHANTOM_QUEENSIDE;
+	}
+
+	acc->king_square[side] = (kings ? BIT_FIRST(kings) : 0);
+	memcpy(acc->values[side], input_biases, sizeof(input_biases));
+
+	for (piece = PAWN; piece < KING; piece++) {
+		bitboard_t bitboard = board->bitboard[piece];
+
+		while (bitboard) {
+			accumulator_add(acc->values[side], input_column(side, acc->king_square[side], piece, BIT_FIRST(bitboard)));
+			bitboard &= bitboard - 1;
+		}
+	}
+
+	acc->dirty[side] = 0;
+}
+
+void nnue_add_piece(board_t *board, int square, int piece) {
+	nnue_accumulator_t *acc = &board->accumulator;
+	int side;
+
+	/* All inputs of a side depend on its king square. */
+	if ((piece & PIECE_MASK) == KING) {
+		acc->dirty[piece & 1] = 1;
+		return;
+	}
+
+	for (side = SIDE_WHITE; side <= SIDE_BLACK; side++)
+		if (!acc->dirty[side])
+			accumulator_add(acc->values[side], input_column(side, acc->king_square[side], piece, square));
+}
+
+void nnue_remove_piece(board_t *board, int square, int piece) {
+	nnue_accumulator_t *acc = &board->accumulator;
+	int side;
+
+	if ((piece & PIECE_MASK) == KING) {
+		acc->dirty[piece & 1] = 1;
+		return;
+	}
+
+	for (side = SIDE_WHITE; side <= SIDE_BLACK; side++)
+		if (!acc->dirty[side])
+			accumulator_sub(acc->values[side], input_column(side, acc->king_square[side], piece, square));
+}
+
+static void clamp_layer(const int *sums, unsigned char *output, int outputs) {
+	int i;
+
+	for (i = 0; i < outputs; i++) {
+		int value = sums[i] >> NNUE_WEIGHT_SHIFT;
+		output[i] = (value < 0 ? 0 : (value > 127 ? 127 : value));
+	}
+}
+
+int nnue_evaluate(board_t *board) {
+	nnue_accumulator_t *acc = &board->accumulator;
+	unsigned char input[2 * NNUE_HALF_DIMS];
+	unsigned char hidden[NNUE_HIDDEN_DIMS];
+	int sums[NNUE_HIDDEN_DIMS];
+	int side = board->current_player;
+	int output;
+	int i;
+
+	if (acc->dirty[SIDE_WHITE])
+		refresh_accumulator(board, SIDE_WHITE);
+	if (acc->dirty[SIDE_BLACK])
+		refresh_accumulator(board, SIDE_BLACK);
+
+	for (i = 0; i < NNUE_HALF_DIMS; i++) {
+		int own = acc->values[side][i];
+		int other = acc->values[OPPONENT(side)][i];
+		input[i] = (own < 0 ? 0 : (own > 127 ? 127 : own));
+		input[NNUE_HALF_DIMS + i] = (other < 0 ? 0 : (other > 127 ? 127 : other));
+	}
+
+	dense(input, 2 * NNUE_HALF_DIMS, hidden1_weights, hidden1_biases, sums, NNUE_HIDDEN_DIMS);
+	clamp_layer(sums, hidden, NNUE_HIDDEN_DIMS);
+	dense(hidden, NNUE_HIDDEN_DIMS, hidden2_weights, hidden2_biases, sums, NNUE_HIDDEN_DIMS);
+	clamp_layer(sums, hidden, NNUE_HIDDEN_DIMS);
+	dense(hidden, NNUE_HIDDEN_DIMS, output_weights, &output_bias, &output, 1);
+
+	return output / NNUE_OUTPUT_SCALE;
+}
@@ -0,0 +1,143 @@
+/*  DreamChess
+**
+**  DreamChess is the legal property of its developers, whose names are too
+**  numerous to list here. Please refer to the AUTHORS.txt file distributed
+**  with this source distribution.
+**
+**  This program is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef DREAMER_NNUE_H
+#define DREAMER_NNUE_H
+
+/* Efficiently updatable neural network evaluation.
+**
+** The network has a HalfKP input layer: for each side, one input for every
+** combination of that side's king square and a non-king piece on a square,
+** both seen from that side (the board is mirrored vertically for black).
+** The first layer sums the weights of the active inputs into an accumulator
+** of NNUE_HALF_DIMS values per side, which add_piece() and remove_piece()
+** keep up to date. The accumulator of the side to move followed by the one
+** of the other side, clamped to 0..127, feeds two clamped dense layers of
+** NNUE_HIDDEN_DIMS outputs each, followed by a single output.
+**
+** Network file format, all values little-endian:
+**
+**   char[4]  magic "DNN1"
+**   uint32   version, must be 1
+**   uint32   number of inputs per side, must be NNUE_INPUTS
+**   uint32   accumulator size, must be NNUE_HALF_DIMS
+**   uint32   hidden layer size, must be NNUE_HIDDEN_DIMS
+**   int16    accumulator biases [NNUE_HALF_DIMS]
+**   int16    accumulator weights [NNUE_INPUTS][NNUE_HALF_DIMS]
+**   int32    hidden layer 1 biases [NNUE_HIDDEN_DIMS]
+**   int8     hidden layer 1 weights [NNUE_HIDDEN_DIMS][2 * NNUE_HALF_DIMS]
+**   int32    hidden layer 2 biases [NNUE_HIDDEN_DIMS]
+**   int8     hidden layer 2 weights [NNUE_HIDDEN_DIMS][NNUE_HIDDEN_DIMS]
+**   int32    output bias
+**   int8     output weights [NNUE_HIDDEN_DIMS]
+**
+** Input index: king_square * 640 + (piece_type * 2 + is_opponent) * 64 +
+** square, where piece_type is 0 (pawn) to 4 (queen) and squares count from
+** A1 = 0 after mirroring. Int8 weights must lie in -127..127. Dense layer
+** sums are shifted right by NNUE_WEIGHT_SHIFT before clamping, and the
+** output is divided by NNUE_OUTPUT_SCALE to give centipawns for the side to
+** move.
+*/
+
+#define NNUE_INPUTS (64 * 640)
+#define NNUE_HALF_DIMS 256
+#define NNUE_HIDDEN_DIMS 32
+#define NNUE_WEIGHT_SHIFT 6
+#define NNUE_OUTPUT_SCALE 16
+
+struct board;
+
+/* First layer outputs of both sides for one board. */
+typedef struct nnue_accumulator {
+	short values[2][NNUE_HALF_DIMS];
+
+	/* King squares the values were computed for. */
+	int king_square[2];
+
+	/* Set when the values of a side must be recomputed from scratch. */
+	int dirty[2];
+} nnue_accumulator_t;
+
+/* Non-zero when a network is loaded and used for evaluation. */
+extern int nnue_enabled;
+
+void nnue_init(void);
+/* Selects the fastest kernels the CPU supports.
+** Parameters: (void)
+** Returns   : (void)
+*/
+
+const char *nnue_kernels(void);
+/* Retrieves the name of the kernels selected by nnue_init().
+** Parameters: (void)
+** Returns   : (const char *): The instruction set name.
+*/
+
+int nnue_load(const char *filename);
+/* Loads a network file and enables network evaluation. On error no network
+** is loaded.
+** Parameters: (const char *) filename: Path of the network file.
+** Returns   : (int): 0 on success, -1 on error.
+*/
+
+int nnue_loaded(void);
+/* Checks whether a network is loaded.
+** Parameters: (void)
+** Returns   : (int): 1 if a network is loaded, 0 otherwise.
+*/
+
+int nnue_enable(int enable);
+/* Switches between network and built-in evaluation. Boards that are already
+** set up must have their accumulators marked dirty when the network is
+** enabled, as they were not kept up to date.
+** Parameters: (int) enable: 1 to evaluate with the network, 0 to use the
+**                 built-in evaluation.
+** Returns   : (int): 0 on success, -1 if no network is loaded.
+*/
+
+void nnue_exit(void);
+/* Frees the network and disables network evaluation.
+** Parameters: (void)
+** Returns   : (void)
+*/
+
+void nnue_add_piece(struct board *board, int square, int piece);
+/* Updates the accumulator for a piece that was added to the board.
+** Parameters: (board_t *) board: The board.
+**             (int) square: The square of the piece.
+**             (int) piece: The piece.
+** Returns   : (void)
+*/
+
+void nnue_remove_piece(struct board *board, int square, int piece);
+/* Updates the accumulator for a piece that was removed from the board.
+** Parameters: (board_t *) board: The board.
+**             (int) square: The square of the piece.
+**             (int) piece: The piece.
+** Returns   : (void)
+*/
+
+int nnue_evaluate(struct board *board);
+/* Evaluates a board with the loaded network.
+** Parameters: (board_t *) board: The board to evaluate.
+** Returns   : (int): The score in centipawns for the side to move.
+*/
+
+#endif
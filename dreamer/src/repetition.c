@@ -19,90 +19,117 @@
 */
 
 #include <stdlib.h>
+#include <string.h>
 
 #include "board.h"
 #include "move.h"
 #include "repetition.h"
+#include "thread.h"
 
-typedef struct rep_list {
-	/* FIXME */
-	long long position[101 + 100];
-	int head;
-} rep_list_t;
+/* Initial number of game positions the key stack has room for. */
+#define KEYS_INITIAL_SIZE 256
 
-static rep_list_t *hist;
-static int hist_idx;
-static rep_list_t *cur_list;
+/* Hash keys of the game positions, followed by those of the positions on
+** the current search path. keys[keys_head - 1] is the current game
+** position, and is_repetition() stores the search position at ply p in
+** keys[keys_head + p]. The stack is grown geometrically so that it always
+** has room for MAX_DEPTH search plies. Each searching thread has its own
+** stack.
+*/
+static THREAD_LOCAL long long *keys;
+static THREAD_LOCAL int keys_size;
+static THREAD_LOCAL int keys_head;
+
+static void keys_reserve(int size) {
+	if (size <= keys_size)
+		return;
+
+	if (keys_size == 0)
+		keys_size = KEYS_INITIAL_SIZE;
+
+	while (keys_size < size)
+		keys_size *= 2;
+
+	keys = realloc(keys, keys_size * sizeof(long long));
+}
 
 void repetition_init(board_t *board) {
-	hist = malloc(sizeof(rep_list_t));
-	hist_idx = 0;
-	cur_list = &hist[0];
-	cur_list->position[0] = board->hash_key;
-	cur_list->head = 1;
+	keys_reserve(1 + MAX_DEPTH + 1);
+	keys[0] = board->hash_key;
+	keys_head = 1;
+}
+
+long long *repetition_save(int *count) {
+	long long *saved = malloc(keys_head * sizeof(long long));
+
+	memcpy(saved, keys, keys_head * sizeof(long long));
+	*count = keys_head;
+	return saved;
+}
+
+void repetition_load(const long long *saved, int count) {
+	keys_reserve(count + MAX_DEPTH + 1);
+	memcpy(keys, saved, count * sizeof(long long));
+	keys_head = count;
 }
 
 void repetition_exit(void) {
-	free(hist);
+	free(keys);
+	keys = NULL;
+	keys_size = 0;
+	keys_head = 0;
 }
 
-void repetition_add(board_t *board, move_t move) {
-	if ((MOVE_GET(move, TYPE) != NORMAL_MOVE) || ((MOVE_GET(move, PIECE) & PIECE_MASK) == PAWN)) {
-		hist_idx++;
-		hist = realloc(hist, sizeof(rep_list_t) * (hist_idx + 1));
-		cur_list = &hist[hist_idx];
-		cur_list->position[0] = board->hash_key;
-		cur_list->head = 1;
-	} else
-		cur_list->position[cur_list->head++] = board->hash_key;
+void repetition_add(board_t *board) {
+	keys_reserve(keys_head + 1 + MAX_DEPTH + 1);
+	keys[keys_head++] = board->hash_key;
 }
 
 void repetition_remove(void) {
-	if (cur_list->head > 1)
-		cur_list->head--;
-	else if (hist_idx > 0) {
-		hist_idx--;
-		cur_list = &hist[hist_idx];
-	}
+	if (keys_head > 1)
+		keys_head--;
 }
 
-int is_repetition(board_t *board, int ply) {
+static int find_key(long long key, int index, int fifty_moves) {
+	/* Counts the earlier positions with a key that have the same side to
+	** move. Positions before the last capture or pawn move can't repeat.
+	*/
+	int first = index - fifty_moves;
+	int count = 0;
 	int i;
-	int cur_head = cur_list->head + ply;
 
-	/* We won't go out of bounds here because of the 50-move rule. */
-	cur_list->position[cur_head] = board->hash_key;
+	if (first < 0)
+		first = 0;
 
-	if (cur_head < 4)
+	for (i = index - 2; i >= first; i -= 2)
+		if (keys[i] == key)
+			count++;
+
+	return count;
+}
+
+int is_repetition(board_t *board, int ply) {
+	int cur_head = keys_head + ply;
+
+	keys[cur_head] = board->hash_key;
+
+	/* A position can't repeat before both sides have moved twice. */
+	if (board->fifty_moves < 4)
 		return 0;
 
 	/* We only check for two occurrences to prevent transposition table
 	** hits that lead to a third repetition without us knowing about it.
 	*/
-	for (i = cur_head - 2; i >= 0; i -= 2)
-		if (board->hash_key == cur_list->position[i])
-			return 1;
-
-	return 0;
+	return find_key(board->hash_key, cur_head, board->fifty_moves) > 0;
 }
 
 int is_draw(board_t *board) {
-	int i;
-	int count = 0;
-
 	/* 50 move rule. */
 	if (board->fifty_moves == 100)
 		return 2;
 
-	if (cur_list->head < 9)
+	if (board->fifty_moves < 8)
 		return 0;
 
-	for (i = cur_list->head - 3; i >= 0; i -= 2) {
-		if (cur_list->position[cur_list->head - 1] == cur_list->position[i])
-			count++;
-		if (count == 2)
-			return 1;
-	}
-
-	return 0;
+	return find_key(keys[keys_head - 1], keys_head - 1, board->fifty_moves) >= 2;
 }
@@ -32,9 +32,23 @@ int is_draw(board_t *board);
 
 void repetition_init(board_t *board);
 
+long long *repetition_save(int *count);
+/* Copies the keys of the game positions, so that another thread can take
+** over the game with repetition_load().
+** Parameters: (int *) count: Returns the number of keys.
+** Returns   : (long long *): The keys, to be freed by the caller.
+*/
+
+void repetition_load(const long long *saved, int count);
+/* Replaces the game positions of this thread with saved ones.
+** Parameters: (const long long *) saved: Keys from repetition_save().
+**             (int) count: The number of keys.
+** Returns   : (void)
+*/
+
 void repetition_exit(void);
 
-void repetition_add(board_t *board, move_t move);
+void repetition_add(board_t *board);
 
 void repetition_remove(void);
 
@@ -26,26 +26,105 @@
 #include "commands.h"
 #include "dreamer.h"
 #include "e_comm.h"
+#include "endgame.h"
 #include "eval.h"
 #include "hashing.h"
 #include "history.h"
 #include "move.h"
 #include "repetition.h"
 #include "search.h"
+#include "tb.h"
+#include "thread.h"
 #include "timer.h"
 #include "transposition.h"
 
 /* #define DEBUG */
 
+/* The clock is checked every POLL_INTERVAL + 1 nodes. Interrupts from the
+** input thread are checked at every node.
+*/
+#define POLL_INTERVAL 1023
+
+/* Depth of the search that ranks the opponent's replies for pondering. */
+#define PONDER_RANK_DEPTH 2
+
 extern int moves_made;
-int abort_search;
+THREAD_LOCAL int abort_search;
 
-static int total_nodes;
-static int start_time;
+static THREAD_LOCAL int total_nodes;
+static THREAD_LOCAL int start_time;
 
 /* Principal variation */
-move_t pv[MAX_DEPTH][MAX_DEPTH];
-int pv_len[MAX_DEPTH];
+THREAD_LOCAL move_t pv[MAX_DEPTH][MAX_DEPTH];
+THREAD_LOCAL int pv_len[MAX_DEPTH];
+
+/* Counters of one search. */
+typedef struct search_stats {
+	/* Nodes of the full-width search and of the quiescence search by ply. */
+	long long nodes[MAX_DEPTH];
+	long long qnodes[MAX_DEPTH];
+	/* Full-width nodes that failed high, and those that did so on the first
+	** legal move.
+	*/
+	long long cutoffs;
+	long long first_move_cutoffs;
+	/* Transposition table lookups, the ones that found an entry of the
+	** board, and the ones whose entry decided the node.
+	*/
+	long long tt_probes;
+	long long tt_hits;
+	long long tt_cuts;
+	/* Nodes decided by the endgame tables. */
+	long long tb_hits;
+	long long eval_probes;
+	long long eval_hits;
+	/* Depth of the last completed iteration, and the time used in
+	** centiseconds.
+	*/
+	int depth;
+	int time;
+} search_stats_t;
+
+/* The counters of the search in progress in this thread, and those of the
+** last search of the main thread.
+*/
+static THREAD_LOCAL search_stats_t stats;
+static search_stats_t last_stats;
+
+/* A reply of the opponent that a helper thread ponders on while the main
+** thread ponders on the hint move. Helpers only leave their results in the
+** transposition table, which the search after the opponent's move picks up.
+*/
+typedef struct ponder_helper {
+	thread_t *thread;
+	board_t board;
+	move_t move;
+	/* The counters of the helper, set when it finishes. */
+	search_stats_t stats;
+} ponder_helper_t;
+
+/* Number of replies pondered on at the same time. */
+static int ponder_moves = 1;
+
+static ponder_helper_t ponder_helpers[PONDER_MAX_MOVES - 1];
+static int ponder_helper_count;
+
+/* Number of helpers that pondered during the last search of the main
+** thread, whose counters are reported with it.
+*/
+static int last_helper_count;
+
+/* Game positions for the repetition checks of the helpers. */
+static long long *ponder_keys;
+static int ponder_key_count;
+
+/* Set to make the helpers stop. */
+static int helpers_stop;
+
+/* Set in helper threads, which leave the clock and the input to the main
+** thread.
+*/
+static THREAD_LOCAL int is_helper;
 
 #if 0
 void print_board(board_t *board)
@@ -139,6 +218,119 @@ static void pv_print(state_t *state, int depth, int score) {
 	e_comm_send("\n");
 }
 
+static double percent(long long part, long long whole) {
+	return whole > 0 ? part * 100.0 / whole : 0.0;
+}
+
+static void stats_print_plies(const char *name, const long long *counts) {
+	int plies = MAX_DEPTH;
+	int i;
+
+	while (plies > 0 && counts[plies - 1] == 0)
+		plies--;
+
+	e_comm_send(",\"%s\":[", name);
+	for (i = 0; i < plies; i++)
+		e_comm_send(i > 0 ? ",%lli" : "%lli", counts[i]);
+	e_comm_send("]");
+}
+
+static void stats_print_json(const search_stats_t *s, int thread, move_t move) {
+	long long nodes = 0;
+	long long qnodes = 0;
+	int i;
+
+	for (i = 0; i < MAX_DEPTH; i++) {
+		nodes += s->nodes[i];
+		qnodes += s->qnodes[i];
+	}
+
+	e_comm_send("# stats {\"thread\":%i", thread);
+	if (move != NO_MOVE) {
+		char *str = coord_move_str(move);
+
+		e_comm_send(",\"move\":\"%s\"", str);
+		free(str);
+	}
+	e_comm_send(",\"depth\":%i,\"time_ms\":%i,\"nodes\":%lli,\"qnodes\":%lli", s->depth, s->time * 10, nodes, qnodes);
+	e_comm_send(",\"cutoffs\":%lli,\"first_move_cutoffs\":%lli", s->cutoffs, s->first_move_cutoffs);
+	e_comm_send(",\"tt_probes\":%lli,\"tt_hits\":%lli,\"tt_cuts\":%lli,\"tb_hits\":%lli", s->tt_probes, s->tt_hits,
+				s->tt_cuts, s->tb_hits);
+	e_comm_send(",\"eval_probes\":%lli,\"eval_hits\":%lli", s->eval_probes, s->eval_hits);
+	stats_print_plies("ply_nodes", s->nodes);
+	stats_print_plies("ply_qnodes", s->qnodes);
+	e_comm_send("}\n");
+}
+
+static void stats_print(const search_stats_t *s) {
+	long long nodes = 0;
+	long long qnodes = 0;
+	int i;
+
+	for (i = 0; i < MAX_DEPTH; i++) {
+		nodes += s->nodes[i];
+		qnodes += s->qnodes[i];
+	}
+
+	e_comm_send("# Depth %i in %i ms\n", s->depth, s->time * 10);
+	e_comm_send("# Nodes: %lli full-width, %lli quiescence (%.1f%%)\n", nodes, qnodes, percent(qnodes, nodes + qnodes));
+	e_comm_send("# Cutoffs: %lli, %lli on the first move (%.1f%%)\n", s->cutoffs, s->first_move_cutoffs,
+				percent(s->first_move_cutoffs, s->cutoffs));
+	e_comm_send("# Hash table: %lli probes, %lli hits (%.1f%%), %lli cutoffs\n", s->tt_probes, s->tt_hits,
+				percent(s->tt_hits, s->tt_probes), s->tt_cuts);
+	e_comm_send("# Endgame tables: %lli hits\n", s->tb_hits);
+	e_comm_send("# Eval cache: %lli probes, %lli hits (%.1f%%)\n", s->eval_probes, s->eval_hits,
+				percent(s->eval_hits, s->eval_probes));
+	e_comm_send("# Ply  Full-width  Quiescence\n");
+
+	for (i = 0; i < MAX_DEPTH; i++)
+		if (s->nodes[i] || s->qnodes[i])
+			e_comm_send("# %3i  %10lli  %10lli\n", i, s->nodes[i], s->qnodes[i]);
+}
+
+void print_search_stats(void) {
+	int i;
+
+	stats_print(&last_stats);
+
+	for (i = 0; i < last_helper_count; i++) {
+		char *str = coord_move_str(ponder_helpers[i].move);
+
+		e_comm_send("# Helper %i, pondering on %s\n", i + 1, str);
+		free(str);
+		stats_print(&ponder_helpers[i].stats);
+	}
+}
+
+static void stats_start(void) {
+	/* Lookups made since the last search don't count. */
+	eval_cache_stats(&stats.eval_probes, &stats.eval_hits);
+	transposition_stats(&stats.tt_probes, &stats.tt_hits);
+	memset(&stats, 0, sizeof(stats));
+
+	/* Helpers report along with the search they ponder beside. */
+	if (!is_helper)
+		last_helper_count = 0;
+}
+
+static void stats_collect(void) {
+	stats.time = get_time() - start_time;
+	eval_cache_stats(&stats.eval_probes, &stats.eval_hits);
+	transposition_stats(&stats.tt_probes, &stats.tt_hits);
+}
+
+static void stats_finish(void) {
+	stats_collect();
+	last_stats = stats;
+
+	if (get_option(OPTION_POST) && stats.eval_probes > 0)
+		e_comm_send("# Eval cache: %lli probes, %lli hits (%.1f%%)\n", stats.eval_probes, stats.eval_hits,
+					percent(stats.eval_hits, stats.eval_probes));
+
+	if (get_option(OPTION_STATS))
+		stats_print_json(&stats, 0, NO_MOVE);
+}
+
 void pv_clear(void) {
 	pv_term(0);
 }
@@ -161,27 +353,37 @@ int alpha_beta(board_t *board, int depth, int ply, int alpha, int beta, int side
 
 int is_check(board_t *board, int ply);
 
-static void poll_abort(int ply) {
+static void poll_abort(void) {
+	if (is_helper) {
+		if (ATOMIC_GET(&helpers_stop))
+			abort_search = 1;
+		return;
+	}
+
 	if (pv_len[0] == 0)
 		return;
 
-	if (check_abort(ply))
+	if (check_abort())
 		abort_search = 1;
 }
 
 static int quiescence(board_t *board, int ply, int alpha, int beta, int side) {
 	int eval;
+	int orig_alpha;
 	bitboard_t en_passant;
 	int castle_flags;
 	int fifty_moves;
 	move_t move;
+	move_t best_move = NO_MOVE;
 
-	if ((total_nodes++) % 10000 == 0)
-		poll_abort(ply);
+	if (((total_nodes++) & POLL_INTERVAL) == 0 || ATOMIC_GET(&search_interrupts))
+		poll_abort();
 
 	if (abort_search)
 		return 0;
 
+	stats.qnodes[ply]++;
+
 	if (is_repetition(board, ply - 1))
 		return 0;
 
@@ -189,6 +391,25 @@ static int quiescence(board_t *board, int ply, int alpha, int beta, int side) {
 	if (compute_legal_moves(board, ply) < 0)
 		return ALPHABETA_ILLEGAL;
 
+	if (get_option(OPTION_QUIESCE)) {
+		switch (lookup_board(board, DEPTH_QUIESCENCE, ply, &eval)) {
+		case EVAL_ACCURATE:
+			stats.tt_cuts++;
+			return eval;
+		case EVAL_LOWERBOUND:
+			if (eval >= beta) {
+				stats.tt_cuts++;
+				return beta;
+			}
+			break;
+		case EVAL_UPPERBOUND:
+			if (eval <= alpha) {
+				stats.tt_cuts++;
+				return alpha;
+			}
+		}
+	}
+
 	eval = board_eval_complete(board, side, alpha, beta);
 
 	if (ply == MAX_DEPTH - 1)
@@ -197,6 +418,8 @@ static int quiescence(board_t *board, int ply, int alpha, int beta, int side) {
 	if (!get_option(OPTION_QUIESCE) || eval >= beta)
 		return eval;
 
+	orig_alpha = alpha;
+
 	if (eval > alpha)
 		alpha = eval;
 
@@ -209,14 +432,18 @@ static int quiescence(board_t *board, int ply, int alpha, int beta, int side) {
 			execute_move(board, move);
 			eval = -quiescence(board, ply + 1, -beta, -alpha, side);
 			unmake_move(board, move, en_passant, castle_flags, fifty_moves);
+			if (abort_search)
+				return 0;
 			if (eval == -ALPHABETA_ILLEGAL)
 				continue;
 			if (eval >= beta) {
-				add_count(move, board->current_player);
+				store_board(board, beta, EVAL_LOWERBOUND, DEPTH_QUIESCENCE, ply, move);
 				return beta;
 			}
-			if (eval > alpha)
+			if (eval > alpha) {
 				alpha = eval;
+				best_move = move;
+			}
 		}
 	}
 
@@ -243,6 +470,12 @@ static int quiescence(board_t *board, int ply, int alpha, int beta, int side) {
 		}
 	}
 
+	if (best_move != NO_MOVE)
+		store_board(board, alpha, (alpha > orig_alpha ? EVAL_ACCURATE : EVAL_UPPERBOUND), DEPTH_QUIESCENCE, ply,
+					best_move);
+	else
+		store_board(board, alpha, EVAL_UPPERBOUND, DEPTH_QUIESCENCE, ply, NO_MOVE);
+
 	return alpha;
 }
 
@@ -255,13 +488,18 @@ int alpha_beta(board_t *board, int depth, int ply, int alpha, int beta, int side
 	int fifty_moves;
 	move_t best_move;
 	move_t move;
+	move_t quiets[256];
+	int quiet_count = 0;
+	int legal_moves = 0;
 
-	if ((total_nodes++) % 10000 == 0)
-		poll_abort(ply);
+	if (((total_nodes++) & POLL_INTERVAL) == 0 || ATOMIC_GET(&search_interrupts))
+		poll_abort();
 
 	if (abort_search)
 		return 0;
 
+	stats.nodes[ply]++;
+
 	if (is_repetition(board, ply - 1)) {
 		pv_term(ply);
 		return 0;
@@ -277,17 +515,53 @@ int alpha_beta(board_t *board, int depth, int ply, int alpha, int beta, int side
 		return 0;
 	}
 
+	if (ply > 0) {
+		int endgame;
+		int wdl;
+
+		if (!tb_probe_wdl(board, &wdl)) {
+			if (compute_legal_moves(board, ply) < 0)
+				return ALPHABETA_ILLEGAL;
+
+			stats.tb_hits++;
+			pv_term(ply);
+
+			/* Prefer the quickest win and the slowest loss. */
+			if (wdl == TB_WIN)
+				return TB_WIN_SCORE - ply;
+			if (wdl == TB_LOSS)
+				return -TB_WIN_SCORE + ply;
+			return 0;
+		}
+
+		endgame = endgame_probe(board, &eval);
+
+		/* Known draws and bitbase results are exact. */
+		if (endgame == ENDGAME_DRAW || endgame == ENDGAME_EXACT) {
+			if (compute_legal_moves(board, ply) < 0)
+				return ALPHABETA_ILLEGAL;
+
+			pv_term(ply);
+			return eval;
+		}
+	}
+
 	switch (lookup_board(board, depth, ply, &eval)) {
 	case EVAL_ACCURATE:
+		stats.tt_cuts++;
 		pv_term(ply);
 		return eval;
 	case EVAL_LOWERBOUND:
-		if (eval >= beta)
+		if (eval >= beta) {
+			stats.tt_cuts++;
 			return beta;
+		}
 		break;
 	case EVAL_UPPERBOUND:
-		if (eval <= alpha)
+		if (eval <= alpha) {
+			stats.tt_cuts++;
 			return alpha;
+		}
 	}
 
 	if (depth == 0 || ply == MAX_DEPTH - 1) {
@@ -314,11 +588,19 @@ int alpha_beta(board_t *board, int depth, int ply, int alpha, int beta, int side
 			return 0;
 		if (score == -ALPHABETA_ILLEGAL)
 			continue;
+		legal_moves++;
 		if (score >= beta) {
-			store_board(board, beta, EVAL_LOWERBOUND, depth, ply, 0 /* FIXME moves_made */, move);
-			add_count(move, board->current_player);
+			stats.cutoffs++;
+			if (legal_moves == 1)
+				stats.first_move_cutoffs++;
+			store_board(board, beta, EVAL_LOWERBOUND, depth, ply, move);
+			/* Captures and promotions are ordered without history. */
+			if (!(move & (CAPTURE_MOVE | CAPTURE_MOVE_EN_PASSANT | MOVE_PROMOTION_MASK)))
+				history_cutoff(ply, board->current_player, depth, move, quiets, quiet_count);
 			return beta;
 		}
+		if (!(move & (CAPTURE_MOVE | CAPTURE_MOVE_EN_PASSANT | MOVE_PROMOTION_MASK)))
+			quiets[quiet_count++] = move;
 		if (score > best_move_score) {
 			if (score > alpha) {
 				eval_type = EVAL_ACCURATE;
@@ -348,15 +630,30 @@ int alpha_beta(board_t *board, int depth, int ply, int alpha, int beta, int side
 		}
 	}
 
-	store_board(board, alpha, eval_type, depth, ply, 0 /* FIXME moves_made */, best_move);
+	store_board(board, alpha, eval_type, depth, ply, best_move);
 
 	return alpha;
 }
 
+static int is_line_move(move_t move, move_t *lines, int count) {
+	/* Checks whether a root move is the move of one of the first count
+	** lines.
+	*/
+	int i;
+
+	for (i = 0; i < count; i++)
+		if (lines[i] == move)
+			return 1;
+
+	return 0;
+}
+
 move_t find_best_move(state_t *state) {
 	int depth = state->depth;
 	board_t *board = &state->board;
 	move_t best_move = NO_MOVE;
+	move_t best_pv[MAX_DEPTH];
+	int best_pv_len = 0;
 	int cur_depth;
 	long long en_passant = board->en_passant;
 	int castle_flags = board->castle_flags;
@@ -365,42 +662,103 @@ move_t find_best_move(state_t *state) {
 	total_nodes = 0;
 	start_time = get_time();
 	abort_search = 0;
+	stats_start();
 	pv_len[0] = 0;
+	history_age();
 
 	timer_start(&state->move_time);
 
+	/* Play tablebase positions straight from the tables. */
+	if (tb_max_pieces) {
+		int score;
+
+		best_move = tb_root_move(board, &score);
+
+		if (best_move != NO_MOVE) {
+			pv_term(1);
+			pv_copy(0, best_move);
+			if (get_option(OPTION_POST))
+				pv_print(state, 1, score);
+			stats_finish();
+			state->hint = NO_MOVE;
+			return best_move;
+		}
+	}
+
 	for (cur_depth = 0; cur_depth < depth; cur_depth++) {
 		int alpha = ALPHABETA_MIN;
-		move_t move;
+		move_t lines[MULTI_PV_MAX];
+		int line;
 
-		compute_legal_moves(board, 0);
+		/* Each line is the best move among those of the earlier lines,
+		** searched with a full window so that its score is exact.
+		*/
+		for (line = 0; line < state->multi_pv; line++) {
+			int line_alpha = ALPHABETA_MIN;
+			move_t move;
+
+			lines[line] = NO_MOVE;
+			compute_legal_moves(board, 0);
+
+			/* e_comm_send("------------------\n"); */
+			while ((move = move_next(board, 0)) != NO_MOVE) {
+				int score;
+
+				if (is_line_move(move, lines, line))
+					continue;
+				/* char *s = coord_move_str(move);
+				e_comm_send("Examining move %s..\n", s);
+				free(s); */
+				execute_move(board, move);
+				score = -alpha_beta(board, cur_depth, 1, ALPHABETA_MIN, -line_alpha, OPPONENT(board->current_player));
+				unmake_move(board, move, en_passant, castle_flags, fifty_moves);
+				/* e_comm_send("Move scored %i\n", score); */
+				if (abort_search) {
+					if (state->flags & FLAG_IGNORE_MOVE) {
+						stats_finish();
+						return NO_MOVE;
+					}
+					break;
+				}
+				if (score == -ALPHABETA_ILLEGAL)
+					continue;
+				if (score > line_alpha) {
+					line_alpha = score;
+					lines[line] = move;
+					pv_copy(0, move);
+					if (line == 0) {
+						alpha = score;
+						best_move = move;
+					}
+					if (get_option(OPTION_POST) && state->multi_pv == 1)
+						pv_print(state, cur_depth + 1, alpha);
+				}
+			}
 
-		/* e_comm_send("------------------\n"); */
-		while ((move = move_next(board, 0)) != NO_MOVE) {
-			int score;
-			/* char *s = coord_move_str(move);
-			e_comm_send("Examining move %s..\n", s);
-			free(s); */
-			execute_move(board, move);
-			score = -alpha_beta(board, cur_depth, 1, ALPHABETA_MIN, -alpha, OPPONENT(board->current_player));
-			unmake_move(board, move, en_passant, castle_flags, fifty_moves);
-			/* e_comm_send("Move scored %i\n", score); */
-			if (abort_search) {
-				if (state->flags & FLAG_IGNORE_MOVE)
-					return NO_MOVE;
+			if (abort_search || lines[line] == NO_MOVE)
 				break;
+
+			if (line == 0) {
+				memcpy(best_pv, pv[0], pv_len[0] * sizeof(move_t));
+				best_pv_len = pv_len[0];
 			}
-			if (score == -ALPHABETA_ILLEGAL)
-				continue;
-			if (score > alpha) {
-				alpha = score;
-				best_move = move;
-				pv_copy(0, move);
+
+			if (state->multi_pv > 1) {
 				if (get_option(OPTION_POST))
-					pv_print(state, cur_depth + 1, alpha);
+					pv_print(state, cur_depth + 1, line_alpha);
+				pv_store_ht(board, 0);
 			}
 		}
 
+		/* The principal variation is that of the first line. */
+		if (line > 0) {
+			memcpy(pv[0], best_pv, best_pv_len * sizeof(move_t));
+			pv_len[0] = best_pv_len;
+		}
+
+		if (!abort_search)
+			stats.depth = cur_depth + 1;
+
 		/* If we found a mate in 'ply' we stop the search */
 		if (alpha == ALPHABETA_MAX - cur_depth) {
 			break;
@@ -420,10 +778,12 @@ move_t find_best_move(state_t *state) {
 
 		pv_store_ht(board, 0);
 
-		if (abort_search)
+		if (abort_search || check_stop(best_move, alpha))
 			break;
 	}
 
+	stats_finish();
+
 	if (best_move == NO_MOVE) {
 		state->hint = NO_MOVE;
 
@@ -458,39 +818,215 @@ move_t find_best_move(state_t *state) {
 	return best_move;
 }
 
+void set_ponder_moves(int count) {
+	ponder_moves = count;
+}
+
+int search_thread_init(void) {
+	if (history_init())
+		return -1;
+
+	if (eval_cache_init()) {
+		history_exit();
+		return -1;
+	}
+
+	return 0;
+}
+
+void search_thread_exit(void) {
+	eval_cache_exit();
+	history_exit();
+}
+
+static int helper_main(void *data) {
+	ponder_helper_t *helper = data;
+	board_t *board = &helper->board;
+	long long en_passant;
+	int castle_flags;
+	int fifty_moves;
+	int depth;
+
+	if (search_thread_init())
+		return 0;
+
+	is_helper = 1;
+	abort_search = 0;
+	start_time = get_time();
+	stats_start();
+
+	repetition_load(ponder_keys, ponder_key_count);
+	execute_move(board, helper->move);
+	repetition_add(board);
+
+	en_passant = board->en_passant;
+	castle_flags = board->castle_flags;
+	fifty_moves = board->fifty_moves;
+
+	for (depth = 0; depth < MAX_DEPTH; depth++) {
+		int alpha = ALPHABETA_MIN;
+		move_t move;
+
+		compute_legal_moves(board, 0);
+
+		while ((move = move_next(board, 0)) != NO_MOVE) {
+			int score;
+
+			execute_move(board, move);
+			score = -alpha_beta(board, depth, 1, ALPHABETA_MIN, -alpha, OPPONENT(board->current_player));
+			unmake_move(board, move, en_passant, castle_flags, fifty_moves);
+			if (abort_search)
+				break;
+			if (score == -ALPHABETA_ILLEGAL)
+				continue;
+			if (score > alpha) {
+				alpha = score;
+				pv_copy(0, move);
+			}
+		}
+
+		if (abort_search || alpha == ALPHABETA_MAX - depth || alpha < ALPHABETA_MIN + 100)
+			break;
+
+		pv_store_ht(board, 0);
+		stats.depth = depth + 1;
+	}
+
+	stats_collect();
+	helper->stats = stats;
+
+	repetition_exit();
+	search_thread_exit();
+	return 0;
+}
+
+static int rank_replies(board_t *board, move_t *replies) {
+	/* Orders the legal moves of the opponent by the score of a shallow
+	** search, which mostly comes from the transposition table entries of
+	** the last search. Returns the number of moves.
+	*/
+	long long en_passant = board->en_passant;
+	int castle_flags = board->castle_flags;
+	int fifty_moves = board->fifty_moves;
+	int scores[256];
+	int count = 0;
+	move_t move;
+
+	/* Commands are only handled once the ponder search has started. */
+	abort_search = 0;
+	pv_term(0);
+
+	compute_legal_moves(board, 0);
+
+	while ((move = move_next(board, 0)) != NO_MOVE) {
+		int score;
+		int i;
+
+		execute_move(board, move);
+		/* Evaluated for our side, like the entries of our own searches. */
+		score = -alpha_beta(board, PONDER_RANK_DEPTH, 1, ALPHABETA_MIN, ALPHABETA_MAX, board->current_player);
+		unmake_move(board, move, en_passant, castle_flags, fifty_moves);
+		if (score == -ALPHABETA_ILLEGAL)
+			continue;
+
+		for (i = count; i > 0 && scores[i - 1] < score; i--) {
+			scores[i] = scores[i - 1];
+			replies[i] = replies[i - 1];
+		}
+		scores[i] = score;
+		replies[i] = move;
+		count++;
+	}
+
+	return count;
+}
+
+static void start_ponder_helpers(state_t *state) {
+	move_t replies[256];
+	int count;
+	int i;
+
+	if (ponder_moves <= 1)
+		return;
+
+	count = rank_replies(&state->board, replies);
+
+	ponder_keys = repetition_save(&ponder_key_count);
+	ATOMIC_SET(&helpers_stop, 0);
+
+	/* The main thread ponders on the hint move. */
+	for (i = 0; i < count && ponder_helper_count < ponder_moves - 1; i++) {
+		ponder_helper_t *helper = &ponder_helpers[ponder_helper_count];
+
+		if (replies[i] == state->hint)
+			continue;
+
+		helper->board = state->board;
+		helper->move = replies[i];
+		helper->thread = thread_create(helper_main, helper);
+		if (!helper->thread)
+			break;
+		ponder_helper_count++;
+	}
+}
+
+void stop_ponder_helpers(void) {
+	int i;
+
+	if (!ponder_keys)
+		return;
+
+	ATOMIC_SET(&helpers_stop, 1);
+
+	for (i = 0; i < ponder_helper_count; i++)
+		thread_join(ponder_helpers[i].thread);
+
+	if (get_option(OPTION_STATS))
+		for (i = 0; i < ponder_helper_count; i++)
+			stats_print_json(&ponder_helpers[i].stats, i + 1, ponder_helpers[i].move);
+
+	last_helper_count = ponder_helper_count;
+	ponder_helper_count = 0;
+	free(ponder_keys);
+	ponder_keys = NULL;
+}
+
 move_t ponder(state_t *state) {
 	move_t move;
 
-	if (state->hint == NO_MOVE)
+	if (state->hint == NO_MOVE) {
+		/* Nothing to ponder on, wait for the opponent. */
+		state->flags &= ~FLAG_PONDER;
 		return NO_MOVE;
+	}
 
 	state->root_board = state->board;
-	state->ponder_actual_move = NO_MOVE;
 	state->ponder_opp_move = state->hint;
+
+	if (begin_search(SEARCH_PONDERING))
+		return NO_MOVE;
+
+	start_ponder_helpers(state);
+
 	do_move(state, state->ponder_opp_move);
-	state->flags = FLAG_DELAY_MOVE;
+	state->flags = FLAG_PONDER;
 
 	set_move_time();
 
 	command_handle(state, "hint");
 	move = find_best_move(state);
-
-	if (state->mode == MODE_QUIT || (state->flags & FLAG_NEW_GAME))
-		return NO_MOVE;
+	stop_ponder_helpers();
+	end_search();
 
 	if (move == NO_MOVE) {
-		/* Player did not play the move we expected */
-		/* or pondering was switched off. */
+		/* Player did not play the move we expected, or another command
+		** stopped the pondering. The command is still queued.
+		*/
 		undo_move(state);
-		if (state->ponder_actual_move != NO_MOVE) {
-			do_move(state, state->ponder_actual_move);
-			check_game_end(state);
-		}
-
 		return NO_MOVE;
 	}
 
-	if (state->flags & FLAG_DELAY_MOVE) {
+	if (state->flags & FLAG_PONDER) {
 		/* Opponent hasn't moved yet. */
 		undo_move(state);
 	}
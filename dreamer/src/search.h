@@ -32,10 +32,52 @@
 #define MAX_NODE 0
 #define MIN_NODE 1
 
+/* Maximum number of opponent replies that are pondered on at the same
+** time.
+*/
+#define PONDER_MAX_MOVES 16
+
 move_t find_best_move(state_t *state);
 
 void pv_clear(void);
 
 move_t ponder(state_t *state);
 
+void set_ponder_moves(int count);
+/* Sets the number of likely opponent replies that are pondered on at the
+** same time. The hint move is pondered on by the main thread, and every
+** other reply by a thread of its own.
+** Parameters: (int) count: The number of replies, 1 to PONDER_MAX_MOVES.
+** Returns   : (void)
+*/
+
+void print_search_stats(void);
+/* Prints the counters of the last search as comment lines: nodes of the
+** full-width and quiescence searches per ply, cutoffs, and hash table,
+** endgame table and evaluation cache hits. If the search was a ponder
+** search, the counters of each helper thread follow those of the main
+** thread.
+** Parameters: (void)
+** Returns   : (void)
+*/
+
+int search_thread_init(void);
+/* Allocates the history tables and evaluation caches of the calling
+** thread, which must be done before it searches.
+** Parameters: (void)
+** Returns   : (int) 0 on success, -1 if there is not enough memory.
+*/
+
+void search_thread_exit(void);
+/* Frees the search state of the calling thread.
+** Parameters: (void)
+** Returns   : (void)
+*/
+
+void stop_ponder_helpers(void);
+/* Stops the threads that ponder on the replies other than the hint move.
+** Parameters: (void)
+** Returns   : (void)
+*/
+
 #endif
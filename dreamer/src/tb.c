@@ -0,0 +1,796 @@
+/*  DreamChess
+**
+**  DreamChess is the legal property of its developers, whose names are too
+**  numerous to list here. Please refer to the AUTHORS.txt file distributed
+**  with this source distribution.
+**
+**  This program is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "board.h"
+#include "move.h"
+#include "repetition.h"
+#include "tb.h"
+
+/* Number of entries in the table of loaded tables. Must be a power of two. */
+#define TB_ENTRIES 512
+
+/* Maximum number of material sets. */
+#define TB_MAX_SETS 256
+
+/* Size of the header before the block offsets. */
+#define TB_HEADER_SIZE 32
+
+/* Version of the file format. */
+#define TB_VERSION 3
+
+static const char tb_magic[4] = {'D', 'T', 'B', '1'};
+
+/* Piece letters in index order, and their values for ordering the sides. */
+static const char piece_letters[] = "KQRBNP";
+static const int letter_pieces[] = {KING, QUEEN, ROOK, BISHOP, KNIGHT, PAWN};
+static const int letter_values[] = {0, 9, 5, 3, 3, 1};
+
+typedef struct tb_table {
+	tb_set_t set;
+	/* Material key with the stronger side as white, or 0 for an empty
+	** entry.
+	*/
+	long long material_key;
+	const unsigned char *data;
+	size_t data_size;
+	int mapped;
+	long long block_size;
+	const unsigned char *offsets[2];
+} tb_table_t;
+
+static tb_table_t tables[TB_ENTRIES];
+
+int tb_max_pieces;
+
+/* Index of each legal pair of king squares without pawns, or -1. */
+static int kk_index[64][64];
+static int kk_squares[462][2];
+static int kings_ready;
+
+static void init_kings(void) {
+	int white_king, black_king;
+	int count = 0;
+
+	for (white_king = 0; white_king < 64; white_king++)
+		for (black_king = 0; black_king < 64; black_king++) {
+			int white_rank = white_king >> 3, white_file = white_king & 7;
+			int black_rank = black_king >> 3, black_file = black_king & 7;
+
+			kk_index[white_king][black_king] = -1;
+
+			/* White king in the triangle A1-D1-D4. */
+			if (white_file > 3 || white_rank > white_file)
+				continue;
+
+			if (abs(white_rank - black_rank) <= 1 && abs(white_file - black_file) <= 1)
+				continue;
+
+			/* With the white king on the diagonal, the black king is on
+			** or below it.
+			*/
+			if (white_rank == white_file && black_rank > black_file)
+				continue;
+
+			kk_squares[count][0] = white_king;
+			kk_squares[count][1] = black_king;
+			kk_index[white_king][black_king] = count++;
+		}
+
+	kings_ready = 1;
+}
+
+static unsigned int read_u16(const unsigned char *p) {
+	return p[0] | (p[1] << 8);
+}
+
+static unsigned int read_u32(const unsigned char *p) {
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+static unsigned long long read_u64(const unsigned char *p) {
+	return read_u32(p) | ((unsigned long long)read_u32(p + 4) << 32);
+}
+
+static int letter_index(char c) {
+	const char *p = strchr(piece_letters, c);
+
+	return p && c ? (int)(p - piece_letters) : -1;
+}
+
+static int side_compare(const char *a, const char *b) {
+	/* Compares the pieces of two sides: more pieces first, then higher
+	** value, then stronger pieces first.
+	*/
+	int value_a = 0, value_b = 0;
+	int i;
+
+	if (strlen(a) != strlen(b))
+		return (int)strlen(a) - (int)strlen(b);
+
+	for (i = 0; a[i]; i++) {
+		value_a += letter_values[letter_index(a[i])];
+		value_b += letter_values[letter_index(b[i])];
+	}
+
+	if (value_a != value_b)
+		return value_a - value_b;
+
+	for (i = 0; a[i]; i++)
+		if (a[i] != b[i])
+			return letter_index(b[i]) - letter_index(a[i]);
+
+	return 0;
+}
+
+int tb_set_from_name(tb_set_t *set, const char *name) {
+	const char *separator = strchr(name, 'v');
+	char sides[2][TB_MAX_PIECES + 1];
+	int side;
+	int i;
+
+	if (!kings_ready)
+		init_kings();
+
+	if (!separator || strlen(name) > TB_MAX_PIECES + 1 || separator - name > TB_MAX_PIECES)
+		return -1;
+
+	memcpy(sides[SIDE_WHITE], name, separator - name);
+	sides[SIDE_WHITE][separator - name] = 0;
+	strcpy(sides[SIDE_BLACK], separator + 1);
+
+	memset(set, 0, sizeof(*set));
+	strcpy(set->name, name);
+
+	/* Each side is a king followed by its pieces in index order. */
+	for (side = SIDE_WHITE; side <= SIDE_BLACK; side++) {
+		if (sides[side][0] != 'K')
+			return -1;
+
+		if (side == SIDE_BLACK)
+			set->black_king_slot = set->count;
+
+		for (i = 0; sides[side][i]; i++) {
+			int letter = letter_index(sides[side][i]);
+
+			if (letter < 0 || (i > 0 && (letter == 0 || letter < letter_index(sides[side][i - 1]))))
+				return -1;
+
+			set->pieces[set->count++] = letter_pieces[letter] + side;
+		}
+	}
+
+	if (set->count < 3 || side_compare(sides[SIDE_WHITE], sides[SIDE_BLACK]) < 0)
+		return -1;
+
+	set->size = 462;
+
+	for (i = 0; i < set->count; i++)
+		if ((set->pieces[i] & PIECE_MASK) == PAWN)
+			set->pawns++;
+
+	if (set->pawns)
+		set->size = 32 * 64;
+
+	for (i = 1; i < set->count; i++)
+		if (i != set->black_king_slot)
+			set->size *= (set->pieces[i] & PIECE_MASK) == PAWN ? 48 : 64;
+
+	return 0;
+}
+
+static void add_sets(tb_set_t *sets, int *count, char *white, int white_len, char *black, int black_len,
+					 int first_letter) {
+	/* Adds the sets with the given white pieces and all black pieces of
+	** black_len letters, from first_letter on, after the ones in black.
+	*/
+	char name[16];
+	int letter;
+
+	if ((int)strlen(black) == black_len) {
+		sprintf(name, "%svK%s", white, black + 1);
+		if (!tb_set_from_name(&sets[*count], name))
+			(*count)++;
+		return;
+	}
+
+	for (letter = first_letter; letter < 6; letter++) {
+		int len = strlen(black);
+
+		black[len] = piece_letters[letter];
+		black[len + 1] = 0;
+		add_sets(sets, count, white, white_len, black, black_len, letter);
+		black[len] = 0;
+	}
+}
+
+static void add_white_sets(tb_set_t *sets, int *count, char *white, int white_len, int black_len, int first_letter) {
+	char black[TB_MAX_PIECES + 1] = "K";
+	int letter;
+
+	if ((int)strlen(white) == white_len) {
+		add_sets(sets, count, white, white_len, black, black_len, 1);
+		return;
+	}
+
+	for (letter = first_letter; letter < 6; letter++) {
+		int len = strlen(white);
+
+		white[len] = piece_letters[letter];
+		white[len + 1] = 0;
+		add_white_sets(sets, count, white, white_len, black_len, letter);
+		white[len] = 0;
+	}
+}
+
+int tb_sets(tb_set_t *sets, int max_pieces) {
+	int count = 0;
+	int pieces;
+
+	for (pieces = 3; pieces <= max_pieces; pieces++) {
+		int pawns;
+
+		/* Sets with fewer pawns come first, as promotions lead to them. */
+		for (pawns = 0; pawns <= pieces - 2; pawns++) {
+			int white_len;
+
+			for (white_len = 2; white_len < pieces; white_len++) {
+				char white[TB_MAX_PIECES + 1] = "K";
+				int first = count;
+				int i;
+
+				add_white_sets(sets, &count, white, white_len, pieces - white_len, 1);
+
+				/* Keep the sets with this number of pawns. */
+				for (i = first; i < count;)
+					if (sets[i].pawns != pawns)
+						sets[i] = sets[--count];
+					else
+						i++;
+			}
+		}
+	}
+
+	return count;
+}
+
+static int transform(int square, int t) {
+	if (t & 1)
+		square ^= 7;
+	if (t & 2)
+		square ^= 56;
+	if (t & 4)
+		square = (square >> 3) | ((square & 7) << 3);
+	return square;
+}
+
+static long long index_squares(const tb_set_t *set, int *squares) {
+	/* Index of a position that is mirrored already. Sorts equal pieces. */
+	long long index;
+	int i, j;
+
+	for (i = 2; i < set->count; i++)
+		for (j = i; j > 1 && set->pieces[j - 1] == set->pieces[j] && squares[j - 1] > squares[j]; j--) {
+			int square = squares[j];
+
+			squares[j] = squares[j - 1];
+			squares[j - 1] = square;
+		}
+
+	if (set->pawns)
+		index = ((squares[0] >> 3) * 4 + (squares[0] & 7)) * 64 + squares[set->black_king_slot];
+	else
+		index = kk_index[squares[0]][squares[set->black_king_slot]];
+
+	for (i = 1; i < set->count; i++) {
+		if (i == set->black_king_slot)
+			continue;
+
+		if ((set->pieces[i] & PIECE_MASK) == PAWN) {
+			if (squares[i] < 8 || squares[i] >= 56)
+				return -1;
+			index = index * 48 + squares[i] - 8;
+		} else
+			index = index * 64 + squares[i];
+	}
+
+	return index;
+}
+
+long long tb_index(const tb_set_t *set, const int *squares) {
+	int mirrored[TB_MAX_PIECES];
+	long long best = -1;
+	int t;
+	int i;
+
+	if (set->pawns) {
+		int flip = (squares[0] & 7) > 3 ? 7 : 0;
+
+		for (i = 0; i < set->count; i++)
+			mirrored[i] = squares[i] ^ flip;
+
+		return index_squares(set, mirrored);
+	}
+
+	/* Up to two of the eight symmetries put the kings in the triangle; the
+	** lowest index is used.
+	*/
+	for (t = 0; t < 8; t++) {
+		long long index;
+
+		if (kk_index[transform(squares[0], t)][transform(squares[set->black_king_slot], t)] < 0)
+			continue;
+
+		for (i = 0; i < set->count; i++)
+			mirrored[i] = transform(squares[i], t);
+
+		index = index_squares(set, mirrored);
+
+		if (best < 0 || (index >= 0 && index < best))
+			best = index;
+	}
+
+	return best;
+}
+
+void tb_squares(const tb_set_t *set, long long index, int *squares) {
+	int i;
+
+	for (i = set->count - 1; i > 0; i--) {
+		if (i == set->black_king_slot)
+			continue;
+
+		if ((set->pieces[i] & PIECE_MASK) == PAWN) {
+			squares[i] = index % 48 + 8;
+			index /= 48;
+		} else {
+			squares[i] = index % 64;
+			index /= 64;
+		}
+	}
+
+	if (set->pawns) {
+		squares[set->black_king_slot] = index % 64;
+		index /= 64;
+		squares[0] = (index / 4) * 8 + index % 4;
+	} else {
+		squares[0] = kk_squares[index][0];
+		squares[set->black_king_slot] = kk_squares[index][1];
+	}
+}
+
+static long long set_material_key(const tb_set_t *set) {
+	long long key = 0;
+	int i;
+
+	for (i = 0; i < set->count; i++)
+		key += MATERIAL_KEY_UNIT(set->pieces[i]);
+
+	return key;
+}
+
+static long long swap_colours(long long material_key) {
+	long long key = 0;
+	int piece;
+
+	for (piece = PAWN; piece <= KING; piece += 2) {
+		key += ((material_key >> (piece * 4)) & 15) * MATERIAL_KEY_UNIT(piece + 1);
+		key += ((material_key >> ((piece + 1) * 4)) & 15) * MATERIAL_KEY_UNIT(piece);
+	}
+
+	return key;
+}
+
+static tb_table_t *find_table(long long material_key) {
+	/* Returns the table for a material key, or the empty entry where it
+	** would be stored.
+	*/
+	unsigned int index = (unsigned int)((material_key * 0x9e3779b97f4a7c15ULL) >> 55);
+
+	while (tables[index & (TB_ENTRIES - 1)].material_key &&
+		   tables[index & (TB_ENTRIES - 1)].material_key != material_key)
+		index++;
+
+	return &tables[index & (TB_ENTRIES - 1)];
+}
+
+static void packed_bytes(const unsigned char *p, const unsigned char *end, int offset, unsigned char *bytes,
+						 int count) {
+	/* Decodes consecutive bytes of a compressed sub-block. Bytes past its
+	** end read as 0.
+	*/
+	memset(bytes, 0, count);
+
+	while (p < end && count > 0) {
+		int control = *p++;
+		int len = control < 128 ? control + 1 : control - 125;
+
+		for (; offset < len && count > 0; offset++, count--)
+			*bytes++ = control < 128 ? p[offset] : *p;
+
+		offset -= len;
+		p += control < 128 ? len : 1;
+	}
+}
+
+static int table_value(const tb_table_t *table, int section, long long position) {
+	/* Decodes the WDL byte or the two DTZ bytes of a position, from the
+	** sub-block that holds it.
+	*/
+	long long block = position / table->block_size;
+	int offset = (int)(position % table->block_size);
+	int subblock = offset / TB_SUBBLOCK_SIZE;
+	int subblocks = (int)(table->block_size / TB_SUBBLOCK_SIZE);
+	const unsigned char *start = table->data + read_u64(table->offsets[section] + 8 * block);
+	const unsigned char *end = table->data + read_u64(table->offsets[section] + 8 * (block + 1));
+	const unsigned char *index = start;
+	const unsigned char *p;
+	unsigned char bytes[2];
+
+	start += 2 * subblocks;
+	if (start > end)
+		return 0;
+
+	p = start + read_u16(index + 2 * subblock);
+	if (subblock + 1 < subblocks && start + read_u16(index + 2 * (subblock + 1)) < end)
+		end = start + read_u16(index + 2 * (subblock + 1));
+
+	offset %= TB_SUBBLOCK_SIZE;
+
+	if (section == 0) {
+		packed_bytes(p, end, offset, bytes, 1);
+		return bytes[0];
+	}
+
+	packed_bytes(p, end, 2 * offset, bytes, 2);
+	return bytes[0] | (bytes[1] << 8);
+}
+
+static int header_is_valid(const unsigned char *data, size_t size, const tb_set_t *set) {
+	long long blocks;
+	long long block_size;
+	long long i;
+
+	if (size < TB_HEADER_SIZE || memcmp(data, tb_magic, sizeof(tb_magic)) || read_u32(data + 4) != TB_VERSION)
+		return 0;
+
+	if ((int)read_u32(data + 8) != set->count || read_u32(data + 20) != set->size)
+		return 0;
+
+	for (i = 0; i < set->count; i++)
+		if (data[12 + i] != set->pieces[i])
+			return 0;
+
+	block_size = read_u32(data + 24);
+	blocks = read_u32(data + 28);
+
+	/* Sub-block starts must fit in 16 bits. */
+	if (block_size == 0 || block_size % TB_SUBBLOCK_SIZE || block_size > 16384 ||
+		blocks != (2 * set->size + block_size - 1) / block_size)
+		return 0;
+
+	if (size < TB_HEADER_SIZE + 16 * (size_t)(blocks + 1))
+		return 0;
+
+	/* Blocks must lie within the file, in order. */
+	for (i = 0; i < 2 * (blocks + 1); i++) {
+		unsigned long long offset = read_u64(data + TB_HEADER_SIZE + 8 * i);
+
+		if (offset > size || (i % (blocks + 1) && offset < read_u64(data + TB_HEADER_SIZE + 8 * (i - 1))))
+			return 0;
+	}
+
+	return 1;
+}
+
+int tb_load(const char *path, const tb_set_t *set) {
+	char filename[1024];
+	tb_table_t *table = find_table(set_material_key(set));
+	unsigned char *data;
+	size_t size;
+	FILE *f;
+
+	if (table->material_key)
+		return 0;
+
+	sprintf(filename, "%.1000s/%s.dtb", path, set->name);
+
+	f = fopen(filename, "rb");
+	if (!f)
+		return -1;
+
+	fseek(f, 0, SEEK_END);
+	size = ftell(f);
+
+#ifndef _WIN32
+	data = mmap(NULL, size, PROT_READ, MAP_SHARED, fileno(f), 0);
+	fclose(f);
+
+	if (data == MAP_FAILED) {
+		perror(filename);
+		return -1;
+	}
+#else
+	fseek(f, 0, SEEK_SET);
+	data = malloc(size);
+
+	if (!data || fread(data, 1, size, f) != size) {
+		fprintf(stderr, "Failed to read %s\n", filename);
+		free(data);
+		fclose(f);
+		return -1;
+	}
+
+	fclose(f);
+#endif
+
+	if (!header_is_valid(data, size, set)) {
+		fprintf(stderr, "%s: invalid tablebase file\n", filename);
+#ifndef _WIN32
+		munmap(data, size);
+#else
+		free(data);
+#endif
+		return -1;
+	}
+
+	table->set = *set;
+	table->material_key = set_material_key(set);
+	table->data = data;
+	table->data_size = size;
+	table->block_size = read_u32(data + 24);
+	table->offsets[0] = data + TB_HEADER_SIZE;
+	table->offsets[1] = data + TB_HEADER_SIZE + 8 * (read_u32(data + 28) + 1);
+
+	if (set->count > tb_max_pieces)
+		tb_max_pieces = set->count;
+
+	return 0;
+}
+
+int tb_init(const char *path) {
+	tb_set_t sets[TB_MAX_SETS];
+	int count = tb_sets(sets, TB_MAX_PIECES);
+	int loaded = 0;
+	int i;
+
+	for (i = 0; i < count; i++)
+		if (!tb_load(path, &sets[i]))
+			loaded++;
+
+	return loaded;
+}
+
+void tb_exit(void) {
+	int i;
+
+	for (i = 0; i < TB_ENTRIES; i++) {
+		if (!tables[i].material_key)
+			continue;
+
+#ifndef _WIN32
+		munmap((void *)tables[i].data, tables[i].data_size);
+#else
+		free((void *)tables[i].data);
+#endif
+		tables[i].material_key = 0;
+	}
+
+	tb_max_pieces = 0;
+}
+
+int tb_probe_pieces(int count, const int *pieces, const int *squares, int side, int *dtz) {
+	int slot_squares[TB_MAX_PIECES];
+	int used[TB_MAX_PIECES] = {0};
+	long long material_key = 0;
+	tb_table_t *table;
+	long long index;
+	int result;
+	int flip = 0;
+	int i, j;
+
+	if (dtz)
+		*dtz = 0;
+
+	/* Two kings. */
+	if (count == 2)
+		return TB_DRAW;
+
+	for (i = 0; i < count; i++)
+		material_key += MATERIAL_KEY_UNIT(pieces[i]);
+
+	table = find_table(material_key);
+
+	if (!table->material_key) {
+		/* Stored with the colours swapped. */
+		table = find_table(swap_colours(material_key));
+		if (!table->material_key)
+			return -1;
+		flip = 1;
+	}
+
+	for (j = 0; j < count; j++)
+		for (i = 0; i < count; i++)
+			if (!used[i] && (pieces[i] ^ flip) == table->set.pieces[j]) {
+				slot_squares[j] = flip ? squares[i] ^ 56 : squares[i];
+				used[i] = 1;
+				break;
+			}
+
+	index = tb_index(&table->set, slot_squares);
+	if (index < 0)
+		return TB_DRAW;
+
+	index += (side ^ flip) * table->set.size;
+	result = table_value(table, 0, index);
+
+	/* Draws have no distance. */
+	if (dtz && result != TB_DRAW)
+		*dtz = table_value(table, 1, index);
+
+	return result;
+}
+
+static int board_probe(board_t *board, int *dtz) {
+	/* Looks up a board in the tables. Returns -1 if it isn't there. */
+	int pieces[TB_MAX_PIECES];
+	int squares[TB_MAX_PIECES];
+	bitboard_t occupied = board->bitboard[WHITE_ALL] | board->bitboard[BLACK_ALL];
+	int count = 0;
+	int piece;
+
+	if (board->castle_flags & (WHITE_CAN_CASTLE_KINGSIDE | BLACK_CAN_CASTLE_KINGSIDE | WHITE_CAN_CASTLE_QUEENSIDE |
+							   BLACK_CAN_CASTLE_QUEENSIDE | PHANTOM_FLAGS))
+		return -1;
+
+	if (BIT_COUNT(occupied) > tb_max_pieces)
+		return -1;
+
+	/* En passant only matters when a pawn can capture. */
+	if (board->en_passant) {
+		bitboard_t pawns = board->bitboard[PAWN + board->current_player];
+		bitboard_t attacks;
+
+		if (board->current_player == SIDE_WHITE)
+			attacks = ((pawns << 7) & ~FILE_MASK(7)) | ((pawns << 9) & ~FILE_MASK(0));
+		else
+			attacks = ((pawns >> 9) & ~FILE_MASK(7)) | ((pawns >> 7) & ~FILE_MASK(0));
+
+		if (attacks & board->en_passant)
+			return -1;
+	}
+
+	for (piece = 0; piece < NR_PIECES; piece++) {
+		bitboard_t bitboard = board->bitboard[piece];
+
+		for (; bitboard; bitboard &= bitboard - 1) {
+			pieces[count] = piece;
+			squares[count++] = BIT_FIRST(bitboard);
+		}
+	}
+
+	return tb_probe_pieces(count, pieces, squares, board->current_player, dtz);
+}
+
+int tb_probe_wdl(board_t *board, int *wdl) {
+	int result;
+	int dtz;
+
+	if (!tb_max_pieces)
+		return -1;
+
+	result = board_probe(board, &dtz);
+	if (result < 0)
+		return -1;
+
+	/* The next capture, promotion or pawn move comes too late. */
+	if (board->fifty_moves + dtz > 100)
+		result = TB_DRAW;
+
+	*wdl = result;
+	return 0;
+}
+
+/* Categories of root moves, from worst to best. Cursed wins and blessed
+** losses are decided by the table but drawn by the 50-move rule.
+*/
+#define ROOT_LOSS 0
+#define ROOT_BLESSED_LOSS 1
+#define ROOT_DRAW 2
+#define ROOT_CURSED_WIN 3
+#define ROOT_WIN 4
+
+move_t tb_root_move(board_t *board, int *score) {
+	bitboard_t en_passant = board->en_passant;
+	int castle_flags = board->castle_flags;
+	int fifty_moves = board->fifty_moves;
+	move_t best_move = NO_MOVE;
+	int best_category = ROOT_LOSS;
+	int best_rank = 0;
+	int i;
+
+	if (!tb_max_pieces || board_probe(board, NULL) < 0 || compute_legal_moves(board, 0) < 0)
+		return NO_MOVE;
+
+	for (i = moves_start[0]; i < moves_start[1]; i++) {
+		move_t move = moves[i];
+		int repetition;
+		int category;
+		int zeroing;
+		int result;
+		int dtz;
+		int rank;
+
+		execute_move(board, move);
+
+		if (compute_legal_moves(board, 1) < 0) {
+			unmake_move(board, move, en_passant, castle_flags, fifty_moves);
+			continue;
+		}
+
+		repetition = is_repetition(board, 0);
+		result = board_probe(board, &dtz);
+		zeroing = board->fifty_moves + dtz;
+		unmake_move(board, move, en_passant, castle_flags, fifty_moves);
+
+		if (result < 0)
+			return NO_MOVE;
+
+		/* Win as fast as possible and lose as slowly as possible, but
+		** prefer results that the 50-move rule doesn't turn into draws.
+		*/
+		if (repetition || result == TB_DRAW) {
+			category = ROOT_DRAW;
+			rank = 0;
+		} else if (result == TB_LOSS) {
+			category = zeroing > 100 ? ROOT_CURSED_WIN : ROOT_WIN;
+			rank = -dtz;
+		} else {
+			category = zeroing > 100 ? ROOT_BLESSED_LOSS : ROOT_LOSS;
+			rank = dtz;
+		}
+
+		if (best_move == NO_MOVE || category > best_category || (category == best_category && rank > best_rank)) {
+			best_move = move;
+			best_category = category;
+			best_rank = rank;
+		}
+	}
+
+	if (best_category == ROOT_WIN)
+		*score = TB_WIN_SCORE;
+	else if (best_category == ROOT_LOSS)
+		*score = -TB_WIN_SCORE;
+	else
+		*score = 0;
+
+	return best_move;
+}
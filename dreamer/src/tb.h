@@ -0,0 +1,195 @@
+/*  DreamChess
+**
+**  DreamChess is the legal property of its developers, whose names are too
+**  numerous to list here. Please refer to the AUTHORS.txt file distributed
+**  with this source distribution.
+**
+**  This program is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef DREAMER_TB_H
+#define DREAMER_TB_H
+
+#include "board.h"
+
+/* Endgame tablebases.
+**
+** A table covers one material set, named after the pieces of the stronger
+** side, 'v' and the pieces of the weaker side, such as "KRPvKR". Positions
+** are stored with the stronger side as white. Castling and en passant are
+** not part of the tables.
+**
+** Positions are indexed by the two king squares followed by the squares of
+** the other pieces in the order of the name, white pieces first. Without
+** pawns, the board is mirrored so that the white king is in the triangle
+** A1-D1-D4, leaving 462 legal king pairs. With pawns, the board is mirrored
+** so that the white king is on files A to D, and pawns are indexed by their
+** square minus 8. Equal pieces are ordered by square.
+**
+** File format, all values little-endian:
+**
+**   char[4]  magic "DTB1"
+**   uint32   version, must be 3
+**   uint32   number of pieces
+**   uint8    piece of each index slot [TB_MAX_PIECES], as in board.h
+**   uint32   number of positions per side to move
+**   uint32   number of positions per block
+**   uint32   number of blocks per section
+**   uint64   start of each WDL block [blocks + 1]
+**   uint64   start of each DTZ block [blocks + 1]
+**   ...      blocks
+**
+** Both sections hold the positions with white to move first. The WDL
+** section holds one byte per position: TB_DRAW, TB_WIN or TB_LOSS for the
+** side to move, with illegal positions stored as draws. The DTZ section
+** holds a uint16 per position: the number of plies to mate or to a
+** capture, promotion or pawn move that keeps the result, or 0 for draws.
+**
+** A block starts with a uint16 for each sub-block of TB_SUBBLOCK_SIZE
+** positions, the start of its data after this index. Sub-blocks are
+** compressed separately with PackBits: a control byte n below 128 is
+** followed by n + 1 literal bytes, otherwise the next byte is repeated
+** n - 125 times.
+**
+** The tables assume that en passant is not possible in the stored position;
+** boards where it is are not probed. The generator does take en passant
+** captures into account after double pushes.
+*/
+
+#define TB_MAX_PIECES 5
+
+/* Number of positions per separately compressed part of a block, which
+** bounds the data a probe decodes.
+*/
+#define TB_SUBBLOCK_SIZE 256
+
+/* Results for the side to move. */
+#define TB_DRAW 0
+#define TB_WIN 1
+#define TB_LOSS 2
+
+/* Score of a won tablebase position, minus the distance from the root. */
+#define TB_WIN_SCORE 20000
+
+/* Material set of a table. */
+typedef struct tb_set {
+	char name[16];
+	int count;
+	/* Piece of each index slot: the white king and white pieces, then the
+	** black king and black pieces.
+	*/
+	int pieces[TB_MAX_PIECES];
+	int black_king_slot;
+	int pawns;
+	/* Number of positions per side to move. */
+	long long size;
+} tb_set_t;
+
+/* Largest number of pieces of the loaded tables, or 0 if none are loaded. */
+extern int tb_max_pieces;
+
+int tb_init(const char *path);
+/* Loads all tables found in a directory.
+** Parameters: (const char *) path: The directory.
+** Returns   : (int): The number of tables loaded.
+*/
+
+void tb_exit(void);
+/* Unloads all tables.
+** Parameters: (void)
+** Returns   : (void)
+*/
+
+int tb_probe_wdl(board_t *board, int *wdl);
+/* Looks up the result of a board. Wins and losses that the 50-move rule
+** turns into draws are reported as draws.
+** Parameters: (board_t *) board: The board.
+**             (int *) wdl: Receives TB_DRAW, TB_WIN or TB_LOSS.
+** Returns   : (int): 0 on success, -1 if the board isn't in the tables.
+*/
+
+move_t tb_root_move(board_t *board, int *score);
+/* Finds the move that keeps the result of a board and makes progress.
+** Moves that repeat a position count as draws, and so do wins and losses
+** that the 50-move rule turns into draws.
+** Parameters: (board_t *) board: The board.
+**             (int *) score: Receives the score of the move, 0 unless
+**                 it wins or loses within the 50-move rule.
+** Returns   : (move_t): The move, or NO_MOVE if the board isn't in the
+**                 tables or has no legal moves.
+*/
+
+/* Functions used by the tablebase generator. */
+
+int tb_sets(tb_set_t *sets, int max_pieces);
+/* Lists all material sets with three to max_pieces pieces, with the sets
+** a set converts to by captures and promotions before the set itself.
+** Parameters: (tb_set_t *) sets: Receives the sets, room for 256.
+**             (int) max_pieces: Largest number of pieces.
+** Returns   : (int): The number of sets.
+*/
+
+int tb_set_from_name(tb_set_t *set, const char *name);
+/* Parses a material set name.
+** Parameters: (tb_set_t *) set: Receives the set.
+**             (const char *) name: The name, such as "KRPvKR".
+** Returns   : (int): 0 on success, -1 if the name is invalid or not in
+**                 the standard colour orientation.
+*/
+
+long long tb_index(const tb_set_t *set, const int *squares);
+/* Computes the index of a position.
+** Parameters: (const tb_set_t *) set: The material set.
+**             (const int *) squares: The square of each index slot.
+** Returns   : (long long): The index, or -1 if the kings are adjacent in
+**                 a set without pawns or a pawn is on the first or last rank.
+*/
+
+void tb_squares(const tb_set_t *set, long long index, int *squares);
+/* Computes the squares of the position with an index.
+** Parameters: (const tb_set_t *) set: The material set.
+**             (long long) index: The index.
+**             (int *) squares: Receives the square of each index slot.
+** Returns   : (void)
+*/
+
+int tb_probe_pieces(int count, const int *pieces, const int *squares, int side, int *dtz);
+/* Looks up the result of a position given as a list of pieces.
+** Parameters: (int) count: The number of pieces.
+**             (const int *) pieces: The pieces.
+**             (const int *) squares: The square of each piece.
+**             (int) side: The side to move.
+**             (int *) dtz: Receives the DTZ value if not NULL.
+** Returns   : (int): TB_DRAW, TB_WIN or TB_LOSS, or -1 if there is no
+**                 table for the pieces.
+*/
+
+int tb_load(const char *path, const tb_set_t *set);
+/* Loads the table of a material set.
+** Parameters: (const char *) path: Directory of the table file.
+**             (const tb_set_t *) set: The material set.
+** Returns   : (int): 0 on success, -1 if there is no valid table.
+*/
+
+int tb_generate(const char *path, const char *what);
+/* Generates tables and writes them to a directory. Tables that already
+** exist are kept.
+** Parameters: (const char *) path: The directory.
+**             (const char *) what: A material set name to generate that set
+**                 and the sets it depends on, or a number of pieces to
+**                 generate all sets up to that number.
+** Returns   : (int): 0 on success, -1 on error.
+*/
+
+#endif
@@ -0,0 +1,973 @@
+/*  DreamChess
+**
+**  DreamChess is the legal property of its developers, whose names are too
+**  numerous to list here. Please refer to the AUTHORS.txt file distributed
+**  with this source distribution.
+**
+**  This program is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _MSC_VER
+#include <windows.h>
+#endif
+
+#include "board.h"
+#include "tb.h"
+#include "thread.h"
+#include "timer.h"
+
+/* Generation of tables by retrograde analysis.
+**
+** Every position of a table gets a state. A first pass marks illegal
+** positions, mates and stalemates, and positions decided by a capture or
+** promotion into a smaller table. Then, for each distance n, the positions
+** decided at distance n - 1 are taken back one move: the predecessor of a
+** lost position is won at distance n, and a predecessor of a won position
+** is lost at distance n if all its moves lead to positions won for the
+** opponent at a smaller distance. Positions still undecided at the end are
+** draws.
+**
+** This first pass counts the distance to mate or to a capture or
+** promotion. Pawn moves reset the 50-move counter as well, so a second
+** pass repeats the analysis with the results of the first, and ends the
+** distance at pawn moves too. That distance is the DTZ stored in the table.
+**
+** Threads work on separate ranges of the positions decided at distance
+** n - 1. Two threads may store a result for the same predecessor, but only
+** the same result, and results found at distance n are never used within
+** the same pass.
+*/
+
+/* Maximum number of threads used for generation. */
+#define TB_GEN_THREADS 64
+
+/* Number of positions per compressed block. */
+#define TB_BLOCK_SIZE 4096
+
+/* Position states. Won and lost states hold the distance in plies. */
+#define STATE_UNKNOWN 0
+#define STATE_ILLEGAL 1
+#define STATE_DRAW 2
+#define STATE_WIN 0x4000
+#define STATE_LOSS 0x8000
+#define STATE_DISTANCE(S) ((S)&0x3fff)
+
+/* Maximum number of moves in a position with TB_MAX_PIECES pieces. */
+#define MAX_MOVES 128
+
+#ifdef _MSC_VER
+#define LOAD_STATE(P) (*(volatile unsigned short *)(P))
+#define STORE_STATE(P, V) (*(volatile unsigned short *)(P) = (V))
+#define SET_BIT(P, B) InterlockedOr64((volatile LONG64 *)(P), (LONG64)(B))
+#else
+#define LOAD_STATE(P) __atomic_load_n(P, __ATOMIC_RELAXED)
+#define STORE_STATE(P, V) __atomic_store_n(P, V, __ATOMIC_RELAXED)
+#define SET_BIT(P, B) __atomic_fetch_or(P, B, __ATOMIC_RELAXED)
+#endif
+
+typedef struct generator {
+	tb_set_t set;
+	/* State of each position, white to move first. */
+	unsigned short *state;
+	/* Positions decided at the previous distance and at the current one. */
+	unsigned long long *decided;
+	unsigned long long *next;
+	long long positions;
+	long long words;
+	int distance;
+	/* Set when a table needed for captures or promotions is missing. */
+	int missing;
+	/* Result of each position from the first pass, or NULL during it. */
+	unsigned char *wdl;
+} generator_t;
+
+/* Range of bitmap words handled by one thread. */
+typedef struct gen_job {
+	generator_t *gen;
+	long long first;
+	long long last;
+} gen_job_t;
+
+/* Position being generated or probed. */
+typedef struct gen_pos {
+	int count;
+	int pieces[TB_MAX_PIECES];
+	int squares[TB_MAX_PIECES];
+	int side;
+	bitboard_t occupied;
+	bitboard_t colour[2];
+} gen_pos_t;
+
+/* Outcome of a legal move: either a position in the table being generated,
+** or the result for the side to move after a capture or promotion.
+*/
+typedef struct gen_move {
+	long long child;
+	int result;
+} gen_move_t;
+
+static bitboard_t king_attacks[64];
+static bitboard_t knight_attacks[64];
+
+static void init_attacks(void) {
+	static const int king_steps[8][2] = {{-1, -1}, {-1, 0}, {-1, 1}, {0, -1}, {0, 1}, {1, -1}, {1, 0}, {1, 1}};
+	static const int knight_steps[8][2] = {{-2, -1}, {-2, 1}, {-1, -2}, {-1, 2}, {1, -2}, {1, 2}, {2, -1}, {2, 1}};
+	int square;
+	int i;
+
+	for (square = 0; square < 64; square++) {
+		king_attacks[square] = 0;
+		knight_attacks[square] = 0;
+
+		for (i = 0; i < 8; i++) {
+			int rank = (square >> 3) + king_steps[i][0];
+			int file = (square & 7) + king_steps[i][1];
+
+			if (rank >= 0 && rank < 8 && file >= 0 && file < 8)
+				king_attacks[square] |= SQUARE_BIT(rank * 8 + file);
+
+			rank = (square >> 3) + knight_steps[i][0];
+			file = (square & 7) + knight_steps[i][1];
+
+			if (rank >= 0 && rank < 8 && file >= 0 && file < 8)
+				knight_attacks[square] |= SQUARE_BIT(rank * 8 + file);
+		}
+	}
+}
+
+static bitboard_t slider_attacks(int square, bitboard_t occupied, int first_direction, int last_direction) {
+	/* Directions 0-3 are straight, 4-7 diagonal. */
+	static const int steps[8][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}, {1, 1}, {1, -1}, {-1, 1}, {-1, -1}};
+	bitboard_t attacks = 0;
+	int i;
+
+	for (i = first_direction; i <= last_direction; i++) {
+		int rank = (square >> 3) + steps[i][0];
+		int file = (square & 7) + steps[i][1];
+
+		while (rank >= 0 && rank < 8 && file >= 0 && file < 8) {
+			attacks |= SQUARE_BIT(rank * 8 + file);
+			if (occupied & SQUARE_BIT(rank * 8 + file))
+				break;
+			rank += steps[i][0];
+			file += steps[i][1];
+		}
+	}
+
+	return attacks;
+}
+
+static bitboard_t piece_attacks(int piece, int square, bitboard_t occupied) {
+	switch (piece & PIECE_MASK) {
+	case PAWN:
+		if (piece & 1)
+			return ((SQUARE_BIT(square) >> 9) & ~FILE_MASK(7)) | ((SQUARE_BIT(square) >> 7) & ~FILE_MASK(0));
+		return ((SQUARE_BIT(square) << 7) & ~FILE_MASK(7)) | ((SQUARE_BIT(square) << 9) & ~FILE_MASK(0));
+	case KNIGHT:
+		return knight_attacks[square];
+	case BISHOP:
+		return slider_attacks(square, occupied, 4, 7);
+	case ROOK:
+		return slider_attacks(square, occupied, 0, 3);
+	case QUEEN:
+		return slider_attacks(square, occupied, 0, 7);
+	default:
+		return king_attacks[square];
+	}
+}
+
+static void update_occupancy(gen_pos_t *pos) {
+	int i;
+
+	pos->colour[SIDE_WHITE] = 0;
+	pos->colour[SIDE_BLACK] = 0;
+
+	for (i = 0; i < pos->count; i++)
+		pos->colour[pos->pieces[i] & 1] |= SQUARE_BIT(pos->squares[i]);
+
+	pos->occupied = pos->colour[SIDE_WHITE] | pos->colour[SIDE_BLACK];
+}
+
+static int is_attacked(gen_pos_t *pos, int square, int side) {
+	/* Whether side attacks a square. */
+	int i;
+
+	for (i = 0; i < pos->count; i++)
+		if ((pos->pieces[i] & 1) == side &&
+			(piece_attacks(pos->pieces[i], pos->squares[i], pos->occupied) & SQUARE_BIT(square)))
+			return 1;
+
+	return 0;
+}
+
+static int king_square(gen_pos_t *pos, int side) {
+	int i;
+
+	for (i = 0; i < pos->count; i++)
+		if (pos->pieces[i] == KING + side)
+			return pos->squares[i];
+
+	return -1;
+}
+
+static void decode(generator_t *gen, long long position, gen_pos_t *pos) {
+	pos->count = gen->set.count;
+	memcpy(pos->pieces, gen->set.pieces, sizeof(pos->pieces));
+	pos->side = position >= gen->set.size;
+	tb_squares(&gen->set, position - pos->side * gen->set.size, pos->squares);
+	update_occupancy(pos);
+}
+
+static long long encode(generator_t *gen, gen_pos_t *pos) {
+	long long index = tb_index(&gen->set, pos->squares);
+
+	return index < 0 ? -1 : index + pos->side * gen->set.size;
+}
+
+static int en_passant_result(generator_t *gen, gen_pos_t *pos, int pawn_slot) {
+	/* Best result for the side to move of capturing en passant a pawn that
+	** just made a double push, or -1 if there is no legal capture.
+	*/
+	int pawn = pos->squares[pawn_slot];
+	int target = pawn + (pos->side == SIDE_WHITE ? 8 : -8);
+	int best = -1;
+	int i;
+
+	for (i = 0; i < pos->count; i++) {
+		gen_pos_t child;
+		int capturer = i;
+		int result;
+
+		if (pos->pieces[i] != PAWN + pos->side || (pos->squares[i] >> 3) != (pawn >> 3) ||
+			abs((pos->squares[i] & 7) - (pawn & 7)) != 1)
+			continue;
+
+		child = *pos;
+		child.count--;
+		child.pieces[pawn_slot] = child.pieces[child.count];
+		child.squares[pawn_slot] = child.squares[child.count];
+		if (capturer == child.count)
+			capturer = pawn_slot;
+		child.squares[capturer] = target;
+		update_occupancy(&child);
+
+		if (is_attacked(&child, king_square(&child, pos->side), OPPONENT(pos->side)))
+			continue;
+
+		child.side = OPPONENT(pos->side);
+		result = tb_probe_pieces(child.count, child.pieces, child.squares, child.side, NULL);
+
+		if (result < 0) {
+			gen->missing = 1;
+			continue;
+		}
+
+		/* The probe gives the result for the opponent. */
+		if (result == TB_LOSS)
+			best = TB_WIN;
+		else if (result == TB_DRAW && best != TB_WIN)
+			best = TB_DRAW;
+		else if (best < 0)
+			best = TB_LOSS;
+	}
+
+	return best;
+}
+
+static int add_move(generator_t *gen, gen_pos_t *pos, int slot, int to, int promotion, gen_move_t *move) {
+	/* Plays a move and stores its outcome. Returns 0 if the move is
+	** illegal.
+	*/
+	gen_pos_t child = *pos;
+	int i;
+
+	child.squares[slot] = to;
+	if (promotion)
+		child.pieces[slot] = promotion;
+
+	/* Remove a captured piece. */
+	for (i = 0; i < child.count; i++)
+		if (i != slot && child.squares[i] == to) {
+			child.count--;
+			child.pieces[i] = child.pieces[child.count];
+			child.squares[i] = child.squares[child.count];
+			break;
+		}
+
+	update_occupancy(&child);
+
+	if (is_attacked(&child, king_square(&child, pos->side), OPPONENT(pos->side)))
+		return 0;
+
+	child.side = OPPONENT(pos->side);
+
+	if (child.count == pos->count && !promotion) {
+		int en_passant = -1;
+
+		move->child = encode(gen, &child);
+		move->result = -1;
+
+		if ((pos->pieces[slot] & PIECE_MASK) == PAWN && abs(to - pos->squares[slot]) == 16)
+			en_passant = en_passant_result(gen, &child, slot);
+
+		/* Positions in the table don't allow en passant. When the opponent
+		** wins by capturing en passant after a double push, the push loses
+		** whatever the child position is worth. Where the capture draws,
+		** the push doesn't win: take_back() doesn't let it in the first
+		** pass, and its result is capped in the second.
+		*/
+		if (en_passant == TB_WIN) {
+			move->child = -1;
+			move->result = TB_WIN;
+		} else if ((pos->pieces[slot] & PIECE_MASK) == PAWN && gen->wdl) {
+			/* The second pass ends the distance at pawn moves. */
+			move->result = gen->wdl[move->child];
+			move->child = -1;
+
+			if (en_passant == TB_DRAW && move->result == TB_LOSS)
+				move->result = TB_DRAW;
+		}
+	} else {
+		move->child = -1;
+		move->result = tb_probe_pieces(child.count, child.pieces, child.squares, child.side, NULL);
+		if (move->result < 0)
+			gen->missing = 1;
+	}
+
+	return 1;
+}
+
+static int generate_moves(generator_t *gen, gen_pos_t *pos, gen_move_t *moves) {
+	/* Generates the outcomes of all legal moves. */
+	static const int promotions[4] = {QUEEN, ROOK, BISHOP, KNIGHT};
+	bitboard_t own = pos->colour[pos->side];
+	bitboard_t enemy = pos->colour[OPPONENT(pos->side)];
+	int count = 0;
+	int i;
+
+	for (i = 0; i < pos->count; i++) {
+		int piece = pos->pieces[i];
+		int from = pos->squares[i];
+		bitboard_t targets;
+
+		if ((piece & 1) != pos->side)
+			continue;
+
+		if ((piece & PIECE_MASK) == PAWN) {
+			int step = pos->side == SIDE_WHITE ? 8 : -8;
+			int start_rank = pos->side == SIDE_WHITE ? 1 : 6;
+
+			targets = piece_attacks(piece, from, pos->occupied) & enemy;
+
+			if (!(pos->occupied & SQUARE_BIT(from + step))) {
+				targets |= SQUARE_BIT(from + step);
+				if ((from >> 3) == start_rank && !(pos->occupied & SQUARE_BIT(from + 2 * step)))
+					targets |= SQUARE_BIT(from + 2 * step);
+			}
+		} else
+			targets = piece_attacks(piece, from, pos->occupied) & ~own;
+
+		for (; targets; targets &= targets - 1) {
+			int to = BIT_FIRST(targets);
+
+			if ((piece & PIECE_MASK) == PAWN && (to < 8 || to >= 56)) {
+				int j;
+
+				for (j = 0; j < 4; j++)
+					count += add_move(gen, pos, i, to, promotions[j] + pos->side, &moves[count]);
+			} else
+				count += add_move(gen, pos, i, to, 0, &moves[count]);
+		}
+	}
+
+	return count;
+}
+
+static void mark(generator_t *gen, long long position, unsigned short state, unsigned long long *bitmap) {
+	STORE_STATE(&gen->state[position], state);
+	SET_BIT(&bitmap[position >> 6], 1ULL << (position & 63));
+}
+
+static int init_thread(void *data) {
+	/* Classifies the positions that don't depend on other positions of the
+	** table.
+	*/
+	gen_job_t *job = data;
+	generator_t *gen = job->gen;
+	gen_move_t moves[MAX_MOVES];
+	long long position;
+
+	for (position = job->first * 64; position < job->last * 64 && position < gen->positions; position++) {
+		gen_pos_t pos;
+		int count;
+		int wins = 0;
+		int losses = 0;
+		int i;
+
+		decode(gen, position, &pos);
+
+		/* Overlapping pieces, positions stored under another index, and
+		** the side that moved left in check.
+		*/
+		if (BIT_COUNT(pos.occupied) != pos.count || encode(gen, &pos) != position ||
+			is_attacked(&pos, king_square(&pos, OPPONENT(pos.side)), pos.side)) {
+			gen->state[position] = STATE_ILLEGAL;
+			continue;
+		}
+
+		count = generate_moves(gen, &pos, moves);
+
+		if (count == 0) {
+			if (is_attacked(&pos, king_square(&pos, pos.side), OPPONENT(pos.side)))
+				mark(gen, position, STATE_LOSS, gen->decided);
+			else
+				gen->state[position] = STATE_DRAW;
+			continue;
+		}
+
+		for (i = 0; i < count; i++) {
+			if (moves[i].result == TB_LOSS)
+				wins++;
+			else if (moves[i].result == TB_WIN)
+				losses++;
+		}
+
+		if (wins)
+			mark(gen, position, STATE_WIN | 1, gen->next);
+		else if (losses == count)
+			mark(gen, position, STATE_LOSS | 1, gen->next);
+	}
+
+	return 0;
+}
+
+static int is_lost(generator_t *gen, long long position) {
+	/* Whether all moves lead to positions won for the opponent at a
+	** distance below the current one.
+	*/
+	gen_move_t moves[MAX_MOVES];
+	gen_pos_t pos;
+	int count;
+	int i;
+
+	decode(gen, position, &pos);
+	count = generate_moves(gen, &pos, moves);
+
+	for (i = 0; i < count; i++) {
+		if (moves[i].child < 0) {
+			if (moves[i].result != TB_WIN)
+				return 0;
+		} else {
+			unsigned short state = LOAD_STATE(&gen->state[moves[i].child]);
+
+			if (!(state & STATE_WIN) || STATE_DISTANCE(state) >= gen->distance)
+				return 0;
+		}
+	}
+
+	return count > 0;
+}
+
+static void take_back(generator_t *gen, long long position) {
+	/* Updates the predecessors of a position decided at the previous
+	** distance.
+	*/
+	unsigned short state = gen->state[position];
+	gen_pos_t pos;
+	int side;
+	int i;
+
+	decode(gen, position, &pos);
+	side = OPPONENT(pos.side);
+
+	for (i = 0; i < pos.count; i++) {
+		int piece = pos.pieces[i];
+		int from = pos.squares[i];
+		bitboard_t sources;
+
+		if ((piece & 1) != side)
+			continue;
+
+		/* Pieces move back the way they came, pawns move backwards. In
+		** the second pass, pawn moves are decided by the first pass.
+		*/
+		if ((piece & PIECE_MASK) == PAWN && gen->wdl)
+			continue;
+
+		if ((piece & PIECE_MASK) == PAWN) {
+			int step = side == SIDE_WHITE ? -8 : 8;
+			int double_rank = side == SIDE_WHITE ? 3 : 4;
+
+			sources = 0;
+			if (from + step >= 8 && from + step < 56 && !(pos.occupied & SQUARE_BIT(from + step))) {
+				sources |= SQUARE_BIT(from + step);
+
+				/* A double push only wins if the opponent loses after
+				** capturing en passant as well.
+				*/
+				if ((from >> 3) == double_rank && !(pos.occupied & SQUARE_BIT(from + 2 * step))) {
+					int result = (state & STATE_LOSS ? en_passant_result(gen, &pos, i) : -1);
+
+					if (result != TB_WIN && result != TB_DRAW)
+						sources |= SQUARE_BIT(from + 2 * step);
+				}
+			}
+		} else
+			sources = piece_attacks(piece, from, pos.occupied) & ~pos.occupied;
+
+		for (; sources; sources &= sources - 1) {
+			long long predecessor;
+
+			pos.squares[i] = BIT_FIRST(sources);
+			pos.side = side;
+			predecessor = encode(gen, &pos);
+			pos.squares[i] = from;
+			pos.side = OPPONENT(side);
+
+			if (predecessor < 0 || LOAD_STATE(&gen->state[predecessor]) != STATE_UNKNOWN)
+				continue;
+
+			if (state & STATE_LOSS)
+				mark(gen, predecessor, STATE_WIN | gen->distance, gen->next);
+			else if (is_lost(gen, predecessor))
+				mark(gen, predecessor, STATE_LOSS | gen->distance, gen->next);
+		}
+	}
+}
+
+static int retro_thread(void *data) {
+	gen_job_t *job = data;
+	long long word;
+
+	for (word = job->first; word < job->last; word++) {
+		unsigned long long bits = job->gen->decided[word];
+
+		for (; bits; bits &= bits - 1)
+			take_back(job->gen, word * 64 + BIT_FIRST(bits));
+	}
+
+	return 0;
+}
+
+static void run_threads(generator_t *gen, int (*func)(void *), int threads) {
+	gen_job_t jobs[TB_GEN_THREADS];
+	thread_t *handles[TB_GEN_THREADS];
+	int i;
+
+	for (i = 0; i < threads; i++) {
+		jobs[i].gen = gen;
+		jobs[i].first = gen->words * i / threads;
+		jobs[i].last = gen->words * (i + 1) / threads;
+	}
+
+	for (i = 1; i < threads; i++)
+		handles[i] = thread_create(func, &jobs[i]);
+
+	func(&jobs[0]);
+
+	for (i = 1; i < threads; i++) {
+		if (handles[i])
+			thread_join(handles[i]);
+		else
+			func(&jobs[i]);
+	}
+}
+
+static int state_value(unsigned short state, int section) {
+	/* WDL or DTZ value of a state. */
+	if (section == 0)
+		return state & STATE_WIN ? TB_WIN : state & STATE_LOSS ? TB_LOSS : TB_DRAW;
+
+	if (!(state & (STATE_WIN | STATE_LOSS)))
+		return 0;
+
+	return STATE_DISTANCE(state);
+}
+
+static int pack_bits(const unsigned char *in, int size, unsigned char *out) {
+	int i = 0;
+	int len = 0;
+
+	while (i < size) {
+		int run = 1;
+
+		while (i + run < size && run < 130 && in[i + run] == in[i])
+			run++;
+
+		if (run >= 3) {
+			out[len++] = run + 125;
+			out[len++] = in[i];
+			i += run;
+		} else {
+			int start = i;
+			int literals = 0;
+
+			/* Literals up to the next run of three. */
+			while (i < size && literals < 128 && !(i + 2 < size && in[i] == in[i + 1] && in[i] == in[i + 2])) {
+				i++;
+				literals++;
+			}
+
+			out[len++] = literals - 1;
+			memcpy(out + len, in + start, literals);
+			len += literals;
+		}
+	}
+
+	return len;
+}
+
+static void write_u16(unsigned char *p, unsigned int value) {
+	p[0] = value & 0xff;
+	p[1] = (value >> 8) & 0xff;
+}
+
+static void write_u32(unsigned char *p, unsigned int value) {
+	p[0] = value & 0xff;
+	p[1] = (value >> 8) & 0xff;
+	p[2] = (value >> 16) & 0xff;
+	p[3] = value >> 24;
+}
+
+static void write_u64(unsigned char *p, unsigned long long value) {
+	write_u32(p, (unsigned int)(value & 0xffffffff));
+	write_u32(p + 4, (unsigned int)(value >> 32));
+}
+
+static int write_table(generator_t *gen, const char *path) {
+	char filename[1024];
+	long long blocks = (gen->positions + TB_BLOCK_SIZE - 1) / TB_BLOCK_SIZE;
+	size_t header_size = 32 + 16 * (blocks + 1);
+	unsigned char *header = calloc(header_size, 1);
+	/* DTZ values take two bytes. Each sub-block adds an index entry and at
+	** most one control byte per 128 bytes and one for the remainder.
+	*/
+	unsigned char block[2 * TB_BLOCK_SIZE];
+	unsigned char packed[2 * TB_BLOCK_SIZE + 8 * (TB_BLOCK_SIZE / TB_SUBBLOCK_SIZE)];
+	unsigned long long offset = header_size;
+	int section;
+	FILE *f;
+	int i;
+
+	sprintf(filename, "%.1000s/%s.dtb", path, gen->set.name);
+
+	f = fopen(filename, "wb");
+	if (!f || !header) {
+		perror(filename);
+		free(header);
+		if (f)
+			fclose(f);
+		return -1;
+	}
+
+	memcpy(header, "DTB1", 4);
+	write_u32(header + 4, 3);
+	write_u32(header + 8, gen->set.count);
+	for (i = 0; i < gen->set.count; i++)
+		header[12 + i] = gen->set.pieces[i];
+	write_u32(header + 20, (unsigned int)gen->set.size);
+	write_u32(header + 24, TB_BLOCK_SIZE);
+	write_u32(header + 28, (unsigned int)blocks);
+
+	/* Blocks are written after the header, which is filled in last. */
+	fseek(f, (long)header_size, SEEK_SET);
+
+	for (section = 0; section < 2; section++) {
+		long long b;
+
+		for (b = 0; b < blocks; b++) {
+			long long first = b * TB_BLOCK_SIZE;
+			int size = (int)(gen->positions - first < TB_BLOCK_SIZE ? gen->positions - first : TB_BLOCK_SIZE);
+			int width = section == 0 ? 1 : 2;
+			int index_size = 2 * (TB_BLOCK_SIZE / TB_SUBBLOCK_SIZE);
+			int len = index_size;
+			int sub;
+
+			for (i = 0; i < size; i++) {
+				int value = state_value(gen->state[first + i], section);
+
+				if (section == 0)
+					block[i] = value;
+				else {
+					block[2 * i] = value & 0xff;
+					block[2 * i + 1] = value >> 8;
+				}
+			}
+
+			/* Sub-blocks past the end of the table are empty. */
+			for (sub = 0; sub < TB_BLOCK_SIZE / TB_SUBBLOCK_SIZE; sub++) {
+				int start = sub * TB_SUBBLOCK_SIZE;
+				int count = size - start < TB_SUBBLOCK_SIZE ? size - start : TB_SUBBLOCK_SIZE;
+
+				write_u16(packed + 2 * sub, len - index_size);
+				if (count > 0)
+					len += pack_bits(block + width * start, width * count, packed + len);
+			}
+
+			write_u64(header + 32 + 8 * (section * (blocks + 1) + b), offset);
+			fwrite(packed, 1, len, f);
+			offset += len;
+		}
+
+		write_u64(header + 32 + 8 * (section * (blocks + 1) + blocks), offset);
+	}
+
+	fseek(f, 0, SEEK_SET);
+	fwrite(header, 1, header_size, f);
+	free(header);
+
+	if (ferror(f) | fclose(f)) {
+		perror(filename);
+		return -1;
+	}
+
+	return 0;
+}
+
+static void solve(generator_t *gen, int threads) {
+	/* Classifies the positions and decides them by increasing distance. */
+	run_threads(gen, init_thread, threads);
+
+	if (gen->missing)
+		return;
+
+	for (gen->distance = 1;; gen->distance++) {
+		unsigned long long *swap;
+		long long word;
+		int empty = 1;
+
+		run_threads(gen, retro_thread, threads);
+
+		swap = gen->decided;
+		gen->decided = gen->next;
+		gen->next = swap;
+		memset(gen->next, 0, gen->words * sizeof(unsigned long long));
+
+		for (word = 0; word < gen->words && empty; word++)
+			if (gen->decided[word])
+				empty = 0;
+
+		if (empty)
+			break;
+	}
+}
+
+static void free_generator(generator_t *gen) {
+	free(gen->state);
+	free(gen->decided);
+	free(gen->next);
+	free(gen->wdl);
+}
+
+static int generate_set(const char *path, const tb_set_t *set, int threads) {
+	generator_t gen;
+	timer t;
+	long long wins = 0, losses = 0, draws = 0;
+	long long position;
+	unsigned char *wdl;
+	int longest = 0;
+
+	memset(&gen, 0, sizeof(gen));
+	gen.set = *set;
+	gen.positions = 2 * set->size;
+	gen.words = (gen.positions + 63) / 64;
+	gen.state = calloc(gen.positions, sizeof(unsigned short));
+	gen.decided = calloc(gen.words, sizeof(unsigned long long));
+	gen.next = calloc(gen.words, sizeof(unsigned long long));
+
+	if (!gen.state || !gen.decided || !gen.next) {
+		fprintf(stderr, "Out of memory generating %s\n", set->name);
+		free_generator(&gen);
+		return -1;
+	}
+
+	timer_init(&t, 0);
+	timer_start(&t);
+
+	printf("Generating %s (%lli positions)\n", set->name, gen.positions);
+	fflush(stdout);
+
+	solve(&gen, threads);
+
+	if (gen.missing) {
+		fprintf(stderr, "Tables needed for %s are missing\n", set->name);
+		free_generator(&gen);
+		return -1;
+	}
+
+	/* The second pass starts over with the results of the first. */
+	wdl = malloc(gen.positions);
+
+	if (!wdl) {
+		fprintf(stderr, "Out of memory generating %s\n", set->name);
+		free_generator(&gen);
+		return -1;
+	}
+
+	for (position = 0; position < gen.positions; position++) {
+		wdl[position] = state_value(gen.state[position], 0);
+		gen.state[position] = STATE_UNKNOWN;
+	}
+
+	gen.wdl = wdl;
+	memset(gen.decided, 0, gen.words * sizeof(unsigned long long));
+	solve(&gen, threads);
+
+	for (position = 0; position < gen.positions; position++) {
+		unsigned short state = gen.state[position];
+
+		if (state & STATE_WIN)
+			wins++;
+		else if (state & STATE_LOSS)
+			losses++;
+		else if (state != STATE_ILLEGAL)
+			draws++;
+
+		if ((state & STATE_WIN) && STATE_DISTANCE(state) > longest)
+			longest = STATE_DISTANCE(state);
+	}
+
+	printf("%s: %lli wins, %lli draws, %lli losses, longest DTZ %i plies, %.1f s\n", set->name, wins, draws, losses,
+		   longest, timer_get(&t) / 100.0);
+
+	if (write_table(&gen, path)) {
+		free_generator(&gen);
+		return -1;
+	}
+
+	free_generator(&gen);
+
+	return tb_load(path, set);
+}
+
+static int set_name(int count, const int *pieces, char *name) {
+	/* Builds the name of the set of some pieces, stronger side first. */
+	static const char letters[] = "PNBRQK";
+	char sides[2][TB_MAX_PIECES + 1];
+	int side;
+
+	for (side = SIDE_WHITE; side <= SIDE_BLACK; side++) {
+		int piece;
+		int len = 0;
+
+		for (piece = KING; piece >= PAWN; piece -= 2) {
+			int i;
+
+			for (i = 0; i < count; i++)
+				if (pieces[i] == piece + side)
+					sides[side][len++] = letters[piece >> 1];
+		}
+
+		sides[side][len] = 0;
+	}
+
+	sprintf(name, "%sv%s", sides[SIDE_WHITE], sides[SIDE_BLACK]);
+	if (count < 3)
+		return -1;
+
+	{
+		tb_set_t set;
+
+		if (tb_set_from_name(&set, name))
+			sprintf(name, "%sv%s", sides[SIDE_BLACK], sides[SIDE_WHITE]);
+	}
+
+	return 0;
+}
+
+static int generate_with_dependencies(const char *path, const tb_set_t *set, int threads) {
+	/* Generates a set after the sets its captures and promotions lead to.
+	** Dependencies are loaded even when the set itself exists, as a
+	** promotion with capture reaches the dependencies of a dependency.
+	*/
+	static const int promotions[4] = {QUEEN, ROOK, BISHOP, KNIGHT};
+	int i;
+
+	for (i = 0; i < set->count; i++) {
+		int pieces[TB_MAX_PIECES];
+		char name[16];
+		tb_set_t dependency;
+		int j;
+
+		if ((set->pieces[i] & PIECE_MASK) == KING)
+			continue;
+
+		/* Capture of the piece. */
+		memcpy(pieces, set->pieces, sizeof(pieces));
+		pieces[i] = pieces[set->count - 1];
+
+		if (!set_name(set->count - 1, pieces, name) && !tb_set_from_name(&dependency, name) &&
+			generate_with_dependencies(path, &dependency, threads))
+			return -1;
+
+		if ((set->pieces[i] & PIECE_MASK) != PAWN)
+			continue;
+
+		for (j = 0; j < 4; j++) {
+			memcpy(pieces, set->pieces, sizeof(pieces));
+			pieces[i] = promotions[j] + (set->pieces[i] & 1);
+
+			if (!set_name(set->count, pieces, name) && !tb_set_from_name(&dependency, name) &&
+				generate_with_dependencies(path, &dependency, threads))
+				return -1;
+		}
+	}
+
+	if (!tb_load(path, set))
+		return 0;
+
+	return generate_set(path, set, threads);
+}
+
+int tb_generate(const char *path, const char *what) {
+	tb_set_t sets[256];
+	int threads = thread_cpu_count();
+	int count;
+	int i;
+
+	if (threads > TB_GEN_THREADS)
+		threads = TB_GEN_THREADS;
+
+	init_attacks();
+
+	if (what[0] >= '0' && what[0] <= '9') {
+		int pieces = atoi(what);
+
+		if (pieces < 3 || pieces > TB_MAX_PIECES) {
+			fprintf(stderr, "Tables can have 3 to %i pieces\n", TB_MAX_PIECES);
+			return -1;
+		}
+
+		count = tb_sets(sets, pieces);
+	} else {
+		if (tb_set_from_name(&sets[0], what)) {
+			fprintf(stderr, "Invalid material set '%s'\n", what);
+			return -1;
+		}
+
+		count = 1;
+	}
+
+	printf("Using %i thread(s)\n", threads);
+
+	for (i = 0; i < count; i++)
+		if (generate_with_dependencies(path, &sets[i], threads))
+			return -1;
+
+	return 0;
+}
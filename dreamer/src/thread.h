@@ -0,0 +1,122 @@
+/*  DreamChess
+**
+**  DreamChess is the legal property of its developers, whose names are too
+**  numerous to list here. Please refer to the AUTHORS.txt file distributed
+**  with this source distribution.
+**
+**  This program is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef DREAMER_THREAD_H
+#define DREAMER_THREAD_H
+
+typedef struct thread thread_t;
+typedef struct mutex mutex_t;
+typedef struct cond cond_t;
+
+/* Reads and writes of an int shared between threads. Writes made before
+** ATOMIC_SET() are visible to a thread that sees the value through
+** ATOMIC_GET(). ATOMIC_OR() sets bits and ATOMIC_EXCHANGE() replaces the
+** value, both returning the old value.
+*/
+#ifdef _MSC_VER
+#include <intrin.h>
+#define ATOMIC_GET(P) (*(volatile int *)(P))
+#define ATOMIC_SET(P, V) (*(volatile int *)(P) = (V))
+#define ATOMIC_OR(P, V) _InterlockedOr((volatile long *)(P), V)
+#define ATOMIC_EXCHANGE(P, V) _InterlockedExchange((volatile long *)(P), V)
+#else
+#define ATOMIC_GET(P) __atomic_load_n(P, __ATOMIC_ACQUIRE)
+#define ATOMIC_SET(P, V) __atomic_store_n(P, V, __ATOMIC_RELEASE)
+#define ATOMIC_OR(P, V) __atomic_fetch_or(P, V, __ATOMIC_ACQ_REL)
+#define ATOMIC_EXCHANGE(P, V) __atomic_exchange_n(P, V, __ATOMIC_ACQ_REL)
+#endif
+
+/* Storage class of variables of which each thread has its own copy. */
+#ifdef _MSC_VER
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+
+thread_t *thread_create(int (*func)(void *), void *data);
+/* Starts a new thread.
+** Parameters: (int (*)(void *)) func: Function to run in the thread.
+**             (void *) data: Argument for func.
+** Returns   : (thread_t *): The new thread, or NULL on error.
+*/
+
+int thread_join(thread_t *thread);
+/* Waits for a thread to finish and frees it.
+** Parameters: (thread_t *) thread: The thread to wait for.
+** Returns   : (int): The return value of the thread function.
+*/
+
+mutex_t *mutex_create(void);
+/* Creates a mutex.
+** Parameters: (void)
+** Returns   : (mutex_t *): The new mutex, or NULL on error.
+*/
+
+void mutex_destroy(mutex_t *mutex);
+/* Frees a mutex.
+** Parameters: (mutex_t *) mutex: The mutex, which must be unlocked.
+** Returns   : (void)
+*/
+
+void mutex_lock(mutex_t *mutex);
+/* Locks a mutex, waiting for other threads to unlock it.
+** Parameters: (mutex_t *) mutex: The mutex.
+** Returns   : (void)
+*/
+
+void mutex_unlock(mutex_t *mutex);
+/* Unlocks a mutex.
+** Parameters: (mutex_t *) mutex: The mutex.
+** Returns   : (void)
+*/
+
+cond_t *cond_create(void);
+/* Creates a condition variable.
+** Parameters: (void)
+** Returns   : (cond_t *): The new condition variable, or NULL on error.
+*/
+
+void cond_destroy(cond_t *cond);
+/* Frees a condition variable.
+** Parameters: (cond_t *) cond: The condition variable, with no waiters.
+** Returns   : (void)
+*/
+
+void cond_wait(cond_t *cond, mutex_t *mutex);
+/* Unlocks a mutex and waits until a condition variable is signalled,
+** then locks the mutex again. Wakeups can be spurious.
+** Parameters: (cond_t *) cond: The condition variable.
+**             (mutex_t *) mutex: The mutex, locked by the caller.
+** Returns   : (void)
+*/
+
+void cond_signal(cond_t *cond);
+/* Wakes up a thread waiting on a condition variable.
+** Parameters: (cond_t *) cond: The condition variable.
+** Returns   : (void)
+*/
+
+int thread_cpu_count(void);
+/* Retrieves the number of processors that are online.
+** Parameters: (void)
+** Returns   : (int): The number of processors, at least 1.
+*/
+
+#endif
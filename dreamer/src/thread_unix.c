@@ -0,0 +1,133 @@
+/*  DreamChess
+**
+**  DreamChess is the legal property of its developers, whose names are too
+**  numerous to list here. Please refer to the AUTHORS.txt file distributed
+**  with this source distribution.
+**
+**  This program is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "thread.h"
+
+struct thread {
+	pthread_t handle;
+	int (*func)(void *);
+	void *data;
+	int ret;
+};
+
+struct mutex {
+	pthread_mutex_t handle;
+};
+
+struct cond {
+	pthread_cond_t handle;
+};
+
+static void *thread_start(void *arg) {
+	thread_t *thread = arg;
+
+	thread->ret = thread->func(thread->data);
+	return NULL;
+}
+
+thread_t *thread_create(int (*func)(void *), void *data) {
+	thread_t *thread = malloc(sizeof(thread_t));
+
+	if (!thread)
+		return NULL;
+
+	thread->func = func;
+	thread->data = data;
+
+	if (pthread_create(&thread->handle, NULL, thread_start, thread)) {
+		free(thread);
+		return NULL;
+	}
+
+	return thread;
+}
+
+int thread_join(thread_t *thread) {
+	int ret;
+
+	pthread_join(thread->handle, NULL);
+	ret = thread->ret;
+	free(thread);
+	return ret;
+}
+
+mutex_t *mutex_create(void) {
+	mutex_t *mutex = malloc(sizeof(mutex_t));
+
+	if (!mutex)
+		return NULL;
+
+	if (pthread_mutex_init(&mutex->handle, NULL)) {
+		free(mutex);
+		return NULL;
+	}
+
+	return mutex;
+}
+
+void mutex_destroy(mutex_t *mutex) {
+	pthread_mutex_destroy(&mutex->handle);
+	free(mutex);
+}
+
+void mutex_lock(mutex_t *mutex) {
+	pthread_mutex_lock(&mutex->handle);
+}
+
+void mutex_unlock(mutex_t *mutex) {
+	pthread_mutex_unlock(&mutex->handle);
+}
+
+cond_t *cond_create(void) {
+	cond_t *cond = malloc(sizeof(cond_t));
+
+	if (!cond)
+		return NULL;
+
+	if (pthread_cond_init(&cond->handle, NULL)) {
+		free(cond);
+		return NULL;
+	}
+
+	return cond;
+}
+
+void cond_destroy(cond_t *cond) {
+	pthread_cond_destroy(&cond->handle);
+	free(cond);
+}
+
+void cond_wait(cond_t *cond, mutex_t *mutex) {
+	pthread_cond_wait(&cond->handle, &mutex->handle);
+}
+
+void cond_signal(cond_t *cond) {
+	pthread_cond_signal(&cond->handle);
+}
+
+int thread_cpu_count(void) {
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+
+	return (count > 0 ? (int)count : 1);
+}
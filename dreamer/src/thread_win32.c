@@ -0,0 +1,131 @@
+/*  DreamChess
+**
+**  DreamChess is the legal property of its developers, whose names are too
+**  numerous to list here. Please refer to the AUTHORS.txt file distributed
+**  with this source distribution.
+**
+**  This program is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+
+/* Condition variables need Windows Vista. */
+#ifndef _WIN32_WINNT
+#define _WIN32_WINNT 0x0600
+#endif
+#include <windows.h>
+
+#include "thread.h"
+
+struct thread {
+	HANDLE handle;
+	int (*func)(void *);
+	void *data;
+	int ret;
+};
+
+struct mutex {
+	CRITICAL_SECTION handle;
+};
+
+struct cond {
+	CONDITION_VARIABLE handle;
+};
+
+static DWORD WINAPI thread_start(LPVOID arg) {
+	thread_t *thread = arg;
+
+	thread->ret = thread->func(thread->data);
+	return 0;
+}
+
+thread_t *thread_create(int (*func)(void *), void *data) {
+	thread_t *thread = malloc(sizeof(thread_t));
+
+	if (!thread)
+		return NULL;
+
+	thread->func = func;
+	thread->data = data;
+	thread->handle = CreateThread(NULL, 0, thread_start, thread, 0, NULL);
+
+	if (!thread->handle) {
+		free(thread);
+		return NULL;
+	}
+
+	return thread;
+}
+
+int thread_join(thread_t *thread) {
+	int ret;
+
+	WaitForSingleObject(thread->handle, INFINITE);
+	CloseHandle(thread->handle);
+	ret = thread->ret;
+	free(thread);
+	return ret;
+}
+
+mutex_t *mutex_create(void) {
+	mutex_t *mutex = malloc(sizeof(mutex_t));
+
+	if (!mutex)
+		return NULL;
+
+	InitializeCriticalSection(&mutex->handle);
+	return mutex;
+}
+
+void mutex_destroy(mutex_t *mutex) {
+	DeleteCriticalSection(&mutex->handle);
+	free(mutex);
+}
+
+void mutex_lock(mutex_t *mutex) {
+	EnterCriticalSection(&mutex->handle);
+}
+
+void mutex_unlock(mutex_t *mutex) {
+	LeaveCriticalSection(&mutex->handle);
+}
+
+cond_t *cond_create(void) {
+	cond_t *cond = malloc(sizeof(cond_t));
+
+	if (!cond)
+		return NULL;
+
+	InitializeConditionVariable(&cond->handle);
+	return cond;
+}
+
+void cond_destroy(cond_t *cond) {
+	free(cond);
+}
+
+void cond_wait(cond_t *cond, mutex_t *mutex) {
+	SleepConditionVariableCS(&cond->handle, &mutex->handle, INFINITE);
+}
+
+void cond_signal(cond_t *cond) {
+	WakeConditionVariable(&cond->handle);
+}
+
+int thread_cpu_count(void) {
+	SYSTEM_INFO info;
+
+	GetSystemInfo(&info);
+	return (info.dwNumberOfProcessors > 0 ? (int)info.dwNumberOfProcessors : 1);
+}
@@ -22,78 +22,70 @@
 #include <assert.h>
 #include <stdlib.h>
 
-#ifdef _MSC_VER
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
 
-#define _W32_FT_OFFSET (116444736000000000ULL)
+static long long clock_us(void) {
+	/* Reads the monotonic clock in microseconds. */
+#ifdef _WIN32
+	static LARGE_INTEGER frequency;
+	LARGE_INTEGER counter;
 
-int gettimeofday(struct timeval *tp, void *tzp) {
-	union {
-		unsigned long long ns100;
-		FILETIME ft;
-	} _now;
+	if (!frequency.QuadPart)
+		QueryPerformanceFrequency(&frequency);
 
-	if (tp) {
-		GetSystemTimeAsFileTime(&_now.ft);
-		tp->tv_usec = (long)((_now.ns100 / 10ULL) % 1000000ULL);
-		tp->tv_sec = (long)((_now.ns100 - _W32_FT_OFFSET) / 10000000ULL);
-	}
+	QueryPerformanceCounter(&counter);
 
-	return 0;
-}
+	return counter.QuadPart / frequency.QuadPart * 1000000 +
+		   counter.QuadPart % frequency.QuadPart * 1000000 / frequency.QuadPart;
+#else
+	struct timespec ts;
 
-#endif
+	clock_gettime(CLOCK_MONOTONIC, &ts);
 
-/* Borrowed from libc.info */
-static int timeval_subtract(struct timeval *result, struct timeval *x, struct timeval *y) {
-	/* Perform the carry for the later subtraction by updating y. */
-	if (x->tv_usec < y->tv_usec) {
-		int nsec = (y->tv_usec - x->tv_usec) / 1000000 + 1;
-		y->tv_usec -= 1000000 * nsec;
-		y->tv_sec += nsec;
-	}
-	if (x->tv_usec - y->tv_usec > 1000000) {
-		int nsec = (x->tv_usec - y->tv_usec) / 1000000;
-		y->tv_usec += 1000000 * nsec;
-		y->tv_sec -= nsec;
-	}
-
-	/* Compute the time remaining to wait.
-		tv_usec is certainly positive. */
-	result->tv_sec = x->tv_sec - y->tv_sec;
-	result->tv_usec = x->tv_usec - y->tv_usec;
-
-	/* Return 1 if result is negative. */
-	return x->tv_sec < y->tv_sec;
+	return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+#endif
 }
 
-static int get_time(timer *c) {
-	struct timeval tv;
-
+static long long get_time(timer *c) {
 	if (!(c->flags & TIMER_RUNNING))
 		return 0;
 
-	gettimeofday(&tv, NULL);
-	timeval_subtract(&tv, &tv, &c->start_time);
+	return clock_us() - c->start_time;
+}
 
-	return tv.tv_sec * 100 + tv.tv_usec / 10000;
+static long long timer_get_us(timer *c) {
+	return c->val + (c->flags & TIMER_DOWN ? -get_time(c) : get_time(c));
 }
 
 int timer_get(timer *c) {
-	return c->val + (c->flags & TIMER_DOWN ? -get_time(c) : get_time(c));
+	return (int)(timer_get_us(c) / 10000);
+}
+
+int timer_get_ms(timer *c) {
+	return (int)(timer_get_us(c) / 1000);
 }
 
 void timer_set(timer *c, int val) {
 	timer_stop(c);
-	c->val = val;
+	c->val = val * 10000LL;
+}
+
+void timer_set_ms(timer *c, int val) {
+	timer_stop(c);
+	c->val = val * 1000LL;
 }
 
 void timer_start(timer *c) {
-	gettimeofday(&c->start_time, NULL);
+	c->start_time = clock_us();
 	c->flags |= TIMER_RUNNING;
 }
 
 void timer_stop(timer *c) {
-	c->val += (c->flags & TIMER_DOWN ? -get_time(c) : get_time(c));
+	c->val = timer_get_us(c);
 	c->flags &= ~TIMER_RUNNING;
 }
 
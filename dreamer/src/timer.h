@@ -21,29 +21,21 @@
 #ifndef DREAMER_TIMER_H
 #define DREAMER_TIMER_H
 
-#ifdef _MSC_VER
-/* Temporary hack for gettimeofday() */
-
-#include <Winsock2.h>
-#undef min
-#undef max
-
-int gettimeofday(struct timeval *tp, void *tzp);
-#else
-#include <sys/time.h>
-#endif
-
 #define TIMER_DOWN (1 << 0)
 #define TIMER_RUNNING (1 << 1)
 
+/* Timers run on a monotonic clock with microsecond resolution. */
 typedef struct {
 	int flags;
-	int val;				   /* Current value */
-	struct timeval start_time; /* Time when clock was started */
+	long long val;		  /* Current value in microseconds */
+	long long start_time; /* Clock reading when the timer was started */
 } timer;
 
+/* Values are in centiseconds, or in milliseconds for the _ms variants. */
 int timer_get(timer *c);
 void timer_set(timer *c, int val);
+int timer_get_ms(timer *c);
+void timer_set_ms(timer *c, int val);
 void timer_start(timer *c);
 void timer_stop(timer *c);
 void timer_init(timer *c, int down);
@@ -18,120 +18,246 @@
 **  along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 #include "board.h"
 #include "hashing.h"
 #include "move.h"
 #include "search.h"
+#include "tb.h"
+#include "thread.h"
 #include "transposition.h"
 
-/* #define DEBUG */
-
 #define ENTRIES (1 << power_of_two)
 int power_of_two;
 
-#ifdef DEBUG
-int queries;
-int hits;
-#endif
-
 int collisions;
 
+/* Lookups by this thread since the last call of transposition_stats(), and
+** the ones that found an entry of the board.
+*/
+static THREAD_LOCAL long long tt_probes;
+static THREAD_LOCAL long long tt_hits;
+
+/* A table entry is two 64-bit words. The data word holds the move, the
+** evaluation, the depth, the evaluation type and the generation. The key word
+** holds the hash key XORed with the data word. Entries are written without
+** locking, so when several threads or processes share the table a reader
+** may see the halves of two different writes. The key check then fails and
+** the entry is treated as empty.
+*/
 typedef struct entry {
-	int eval_type;
-	int eval;
-	int depth;
-	unsigned long long hash_key;
-	int time_stamp;
-	move_t move;
+	unsigned long long key;
+	unsigned long long data;
 } entry_t;
 
+#define DATA_MOVE(D) ((move_t)((D)&0xffffffff))
+#define DATA_EVAL(D) ((int)(short)((D) >> 32))
+#define DATA_DEPTH(D) ((int)(signed char)((D) >> 48))
+#define DATA_EVAL_TYPE(D) ((int)((D) >> 56) & 7)
+#define DATA_GENERATION(D) ((unsigned int)((D) >> 59) & 31)
+#define DATA_GENERATION_MASK (31ULL << 59)
+
+#define DATA(MOVE, EVAL, DEPTH, EVAL_TYPE, GENERATION)                                                                 \
+	((unsigned long long)(unsigned int)(MOVE) | (unsigned long long)(unsigned short)(EVAL) << 32 |                     \
+	 (unsigned long long)(unsigned char)(DEPTH) << 48 | (unsigned long long)(EVAL_TYPE) << 56 |                        \
+	 (unsigned long long)((GENERATION)&31) << 59)
+
+/* Version of the entry format in hash table files. Increase this whenever
+** entry_t changes.
+*/
+#define TT_FILE_VERSION 3
+
+/* Header of a hash table file or shared memory object. It is padded to 64
+** bytes so that the entries that follow it keep their alignment.
+*/
+typedef union file_header {
+	struct {
+		char magic[4];
+		unsigned int version;
+		unsigned int entry_size;
+		unsigned int power_of_two;
+		unsigned long long zobrist_seed;
+		unsigned int generation;
+	} h;
+	char pad[64];
+} file_header_t;
+
+static const char file_magic[4] = {'D', 'T', 'T', '\n'};
+
 entry_t *table;
 
-void store_board(board_t *board, int eval, int eval_type, int depth, int ply, int time_stamp, move_t move) {
-	int index = board->hash_key & (ENTRIES - 1);
+/* Generation of the table. Stored in each entry to tell results of earlier
+** games and engine runs apart. Entries of an earlier generation are still
+** used, but are replaced whatever their depth.
+*/
+static unsigned int generation;
+
+/* Entries store the generation as a tag of 1 to 31. Tag 0 marks entries of
+** earlier cycles of tags, which are retagged whenever the tags wrap, so that
+** they never pass for entries of the current generation.
+*/
+#define GENERATION_TAG(G) ((G) % 31 + 1)
+
+/* Header of the mapped hash table file or shared memory object, or NULL when
+** the table lives in ordinary memory.
+*/
+static file_header_t *file_header;
+static size_t file_size;
+
+/* Name of the shared memory object, or NULL when the table isn't shared. */
+static char *shm_name;
+
+static int probe(board_t *board, unsigned long long *data) {
+	volatile entry_t *entry = &table[board->hash_key & (ENTRIES - 1)];
+	unsigned long long key = entry->key;
+
+	*data = entry->data;
+
+	if (DATA_EVAL_TYPE(*data) == EVAL_NONE)
+		return 0;
+
+	return (key ^ *data) == (unsigned long long)board->hash_key;
+}
+
+static void put(board_t *board, unsigned long long data) {
+	volatile entry_t *entry = &table[board->hash_key & (ENTRIES - 1)];
+
+	entry->key = board->hash_key ^ data;
+	entry->data = data;
+}
+
+void store_board(board_t *board, int eval, int eval_type, int depth, int ply, move_t move) {
+	unsigned long long data;
+	int found = probe(board, &data);
+	int current = DATA_GENERATION(data) == GENERATION_TAG(generation);
 
-	if ((table[index].eval_type != EVAL_NONE) && (table[index].hash_key == board->hash_key) &&
-		(table[index].depth > depth))
+	if (found && current && (DATA_DEPTH(data) > depth))
 		/* Do not overwrite entries for this board at greater depth. */
 		return;
 
-	/* Make mate-in-n values relative to board that's to be stored */
-	if (eval < ALPHABETA_MIN + 1000)
+	if ((depth == DEPTH_QUIESCENCE) && (DATA_EVAL_TYPE(data) != EVAL_NONE) && current && (DATA_DEPTH(data) > depth))
+		/* Quiescence results only replace other quiescence results. */
+		return;
+
+	/* Make mate-in-n and tablebase values relative to board that's to be
+	** stored
+	*/
+	if (eval < -TB_WIN_SCORE + 1000)
 		eval -= ply;
-	else if (eval > ALPHABETA_MAX - 1000)
+	else if (eval > TB_WIN_SCORE - 1000)
 		eval += ply;
 
-	table[index].hash_key = board->hash_key;
-	table[index].eval = eval;
-	table[index].eval_type = eval_type;
-	table[index].depth = depth;
-	table[index].time_stamp = time_stamp;
-	table[index].move = move;
+	put(board, DATA(move, eval, depth, eval_type, GENERATION_TAG(generation)));
 }
 
 void set_best_move(board_t *board, move_t move) {
-	int index = board->hash_key & (ENTRIES - 1);
+	unsigned long long data;
 
-	if ((table[index].eval_type == EVAL_NONE) || (table[index].hash_key != board->hash_key))
-		store_board(board, 0, EVAL_PV, 0, 0, 0, move);
+	if (!probe(board, &data))
+		store_board(board, 0, EVAL_PV, 0, 0, move);
 	else
-		table[index].move = move;
+		put(board, DATA(move, DATA_EVAL(data), DATA_DEPTH(data), DATA_EVAL_TYPE(data), GENERATION_TAG(generation)));
 }
 
 int lookup_board(board_t *board, int depth, int ply, int *eval) {
-	int index = board->hash_key & (ENTRIES - 1);
+	unsigned long long data;
 
-#ifdef DEBUG
-	if (queries == 100000) {
-		e_comm_send("TT hit rate:: %.2f%%\n", hits / (float)queries * 100);
-		queries = 0;
-		hits = 0;
-	}
-	queries++;
-#endif
-	if (table[index].eval_type == EVAL_NONE)
-		return EVAL_NONE;
+	tt_probes++;
 
-	if (table[index].hash_key != board->hash_key)
+	if (!probe(board, &data))
 		return EVAL_NONE;
-#ifdef DEBUG
-	hits++;
-#endif
 
-	if (table[index].depth < depth || table[index].eval_type == EVAL_PV)
+	tt_hits++;
+
+	if (DATA_DEPTH(data) < depth || DATA_EVAL_TYPE(data) == EVAL_PV)
 		return EVAL_NONE;
 
-	*eval = table[index].eval;
+	*eval = DATA_EVAL(data);
 
-	/* Make mate-in-n values relative to current game position */
-	if (*eval < ALPHABETA_MIN + 1000)
+	/* Make mate-in-n and tablebase values relative to current game
+	** position
+	*/
+	if (*eval < -TB_WIN_SCORE + 1000)
 		*eval += ply;
-	else if (*eval > ALPHABETA_MAX - 1000)
+	else if (*eval > TB_WIN_SCORE - 1000)
 		*eval -= ply;
 
-	return table[index].eval_type;
+	return DATA_EVAL_TYPE(data);
+}
+
+void transposition_stats(long long *probes, long long *hits) {
+	*probes = tt_probes;
+	*hits = tt_hits;
+	tt_probes = 0;
+	tt_hits = 0;
 }
 
 move_t lookup_best_move(board_t *board) {
-	int index = board->hash_key & (ENTRIES - 1);
+	unsigned long long data;
 
-	if ((table[index].eval_type == EVAL_NONE) || (table[index].hash_key != board->hash_key))
+	if (!probe(board, &data))
 		return NO_MOVE;
 
-	return table[index].move;
+	return DATA_MOVE(data);
+}
+
+#ifndef _WIN32
+static void retire_generations(void) {
+	/* Retags all entries as belonging to an earlier cycle of generation
+	** tags. The key word is rewritten along with the data word, as it
+	** holds the hash key XORed with it.
+	*/
+	int i;
+
+	for (i = 0; i < ENTRIES; i++) {
+		volatile entry_t *entry = &table[i];
+		unsigned long long key = entry->key;
+		unsigned long long data = entry->data;
+
+		if (DATA_EVAL_TYPE(data) == EVAL_NONE || !DATA_GENERATION(data))
+			continue;
+
+		entry->key = key ^ (data & DATA_GENERATION_MASK);
+		entry->data = data & ~DATA_GENERATION_MASK;
+	}
 }
+#endif
 
 void clear_table(void) {
 	int i;
+
+#ifndef _WIN32
+	if (file_header) {
+		/* Results in a hash table file are meant to outlive a game, and a
+		** shared table is still in use by other processes, so we only move
+		** on to the next generation. The process that makes the tags wrap
+		** retires the entries that still carry them.
+		*/
+		generation = __sync_add_and_fetch(&file_header->h.generation, 1);
+		if (GENERATION_TAG(generation) == 1)
+			retire_generations();
+		return;
+	}
+#endif
+
 	for (i = 0; i < ENTRIES; i++) {
-		table[i].eval_type = EVAL_NONE;
+		table[i].key = 0;
+		table[i].data = 0;
 	}
 }
 
-void transposition_init(int megabytes) {
+static int size_to_power_of_two(int megabytes) {
 	int i = 0;
 	int x = 2;
 
@@ -142,8 +268,14 @@ void transposition_init(int megabytes) {
 		i++;
 	}
 
-	x /= 2;
-	power_of_two = i;
+	return i;
+}
+
+void transposition_init(int megabytes) {
+	int x;
+
+	power_of_two = size_to_power_of_two(megabytes);
+	x = ENTRIES;
 
 	printf("Hash table size: %i MB\n", x * (int)sizeof(entry_t) / 1024768);
 	table = malloc(x * sizeof(entry_t));
@@ -154,6 +286,282 @@ void transposition_init(int megabytes) {
 	}
 }
 
+#ifndef _WIN32
+
+static int header_is_valid(file_header_t *header, size_t size) {
+	if (memcmp(header->h.magic, file_magic, sizeof(file_magic)))
+		return 0;
+
+	if (header->h.version != TT_FILE_VERSION || header->h.entry_size != sizeof(entry_t))
+		return 0;
+
+	if (header->h.zobrist_seed != ZOBRIST_SEED || header->h.power_of_two >= 8 * sizeof(int) - 1)
+		return 0;
+
+	return size == sizeof(file_header_t) + ((size_t)1 << header->h.power_of_two) * sizeof(entry_t);
+}
+
+static void write_header(void) {
+	memcpy(file_header->h.magic, file_magic, sizeof(file_magic));
+	file_header->h.version = TT_FILE_VERSION;
+	file_header->h.entry_size = sizeof(entry_t);
+	file_header->h.power_of_two = power_of_two;
+	file_header->h.zobrist_seed = ZOBRIST_SEED;
+	file_header->h.generation = 0;
+}
+
+static int map_table(int fd, const char *name) {
+	void *map = mmap(NULL, file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+	if (map == MAP_FAILED) {
+		perror(name);
+		return 1;
+	}
+
+	file_header = map;
+	table = (entry_t *)(file_header + 1);
+	return 0;
+}
+
+int transposition_init_file(const char *filename, int megabytes) {
+	file_header_t header;
+	struct stat st;
+	int fd;
+	int valid = 0;
+
+	fd = open(filename, O_RDWR | O_CREAT, 0644);
+
+	if (fd < 0 || fstat(fd, &st)) {
+		perror(filename);
+		if (fd >= 0)
+			close(fd);
+		return 1;
+	}
+
+	if ((size_t)st.st_size >= sizeof(file_header_t) && read(fd, &header, sizeof(header)) == sizeof(header))
+		valid = header_is_valid(&header, st.st_size);
+
+	if (valid) {
+		power_of_two = header.h.power_of_two;
+		file_size = st.st_size;
+	} else {
+		if (st.st_size > 0)
+			fprintf(stderr, "%s: incompatible hash table file, reinitializing\n", filename);
+
+		power_of_two = size_to_power_of_two(megabytes);
+		file_size = sizeof(file_header_t) + (size_t)ENTRIES * sizeof(entry_t);
+
+		/* Truncating to zero first makes sure all entries read as
+		** EVAL_NONE.
+		*/
+		if (ftruncate(fd, 0) || ftruncate(fd, file_size)) {
+			perror(filename);
+			close(fd);
+			return 1;
+		}
+	}
+
+	if (map_table(fd, filename)) {
+		close(fd);
+		return 1;
+	}
+
+	close(fd);
+
+	if (!valid)
+		write_header();
+
+	generation = file_header->h.generation;
+
+	printf("Hash table file: %s, %i MB, generation %u\n", filename, ENTRIES * (int)sizeof(entry_t) / 1024768,
+		   generation);
+
+	return 0;
+}
+
+/* Byte offsets of the locks on a shared memory object. Attaching and
+** detaching hold the setup lock, so that only one process at a time sets up
+** or removes the object. Every attached process holds a read lock on the
+** user byte, which the system releases when the process exits or crashes.
+** A process that can write-lock the user byte is therefore the only user.
+*/
+#define SHM_SETUP_LOCK 0
+#define SHM_USER_LOCK 1
+
+/* Descriptor of the shared memory object, which must stay open to keep the
+** locks.
+*/
+static int shm_fd = -1;
+
+static int lock_byte(int fd, int byte, int type, int wait) {
+	struct flock lock;
+
+	memset(&lock, 0, sizeof(lock));
+	lock.l_type = type;
+	lock.l_whence = SEEK_SET;
+	lock.l_start = byte;
+	lock.l_len = 1;
+
+	return fcntl(fd, wait ? F_SETLKW : F_SETLK, &lock);
+}
+
+static void detach_shm(void) {
+	if (!shm_name)
+		return;
+
+	/* The last process to detach removes the shared memory object. */
+	lock_byte(shm_fd, SHM_SETUP_LOCK, F_WRLCK, 1);
+	if (!lock_byte(shm_fd, SHM_USER_LOCK, F_WRLCK, 0))
+		shm_unlink(shm_name);
+
+	munmap(file_header, file_size);
+	file_header = NULL;
+	table = NULL;
+
+	/* Closing the descriptor releases the locks. */
+	close(shm_fd);
+	shm_fd = -1;
+	free(shm_name);
+	shm_name = NULL;
+}
+
+int transposition_init_shm(const char *name, int megabytes) {
+	char *obj_name = malloc(strlen(name) + 2);
+	struct stat st;
+	int creator;
+	int fd;
+
+	/* Portable shared memory object names start with a slash. */
+	sprintf(obj_name, "%s%s", (name[0] == '/' ? "" : "/"), name);
+
+	for (;;) {
+		fd = shm_open(obj_name, O_RDWR | O_CREAT, 0600);
+
+		if (fd < 0 || lock_byte(fd, SHM_SETUP_LOCK, F_WRLCK, 1) || fstat(fd, &st)) {
+			perror(obj_name);
+			if (fd >= 0)
+				close(fd);
+			free(obj_name);
+			return 1;
+		}
+
+		/* The last user may have removed the object while we waited for
+		** the lock. Then we start over with a new one.
+		*/
+		if (st.st_nlink > 0)
+			break;
+
+		close(fd);
+	}
+
+	/* Without other users the table is set up anew. That includes an
+	** object left behind by processes that crashed.
+	*/
+	creator = !lock_byte(fd, SHM_USER_LOCK, F_WRLCK, 0);
+
+	if (creator) {
+		power_of_two = size_to_power_of_two(megabytes);
+		file_size = sizeof(file_header_t) + (size_t)ENTRIES * sizeof(entry_t);
+
+		/* Truncating to zero first makes sure all entries read as
+		** EVAL_NONE.
+		*/
+		if (ftruncate(fd, 0) || ftruncate(fd, file_size)) {
+			perror(obj_name);
+			shm_unlink(obj_name);
+			close(fd);
+			free(obj_name);
+			return 1;
+		}
+	} else
+		file_size = st.st_size;
+
+	if (map_table(fd, obj_name)) {
+		if (creator)
+			shm_unlink(obj_name);
+		close(fd);
+		free(obj_name);
+		return 1;
+	}
+
+	if (creator)
+		write_header();
+	else if (!header_is_valid(file_header, file_size)) {
+		fprintf(stderr, "%s: incompatible shared hash table\n", obj_name);
+		munmap(file_header, file_size);
+		file_header = NULL;
+		close(fd);
+		free(obj_name);
+		return 1;
+	} else
+		power_of_two = file_header->h.power_of_two;
+
+	/* For the creator this turns its write lock into a read lock. */
+	lock_byte(fd, SHM_USER_LOCK, F_RDLCK, 0);
+	lock_byte(fd, SHM_SETUP_LOCK, F_UNLCK, 0);
+
+	shm_fd = fd;
+	shm_name = obj_name;
+	generation = file_header->h.generation;
+
+	/* Make sure we detach when the engine exits without cleaning up. */
+	atexit(detach_shm);
+
+	printf("Shared hash table: %s, %i MB, %s\n", shm_name, ENTRIES * (int)sizeof(entry_t) / 1024768,
+		   creator ? "created" : "attached");
+
+	return 0;
+}
+
+#else
+
+int transposition_init_file(const char *filename, int megabytes) {
+	fprintf(stderr, "Hash table files are not supported on this platform\n");
+	return 1;
+}
+
+int transposition_init_shm(const char *name, int megabytes) {
+	fprintf(stderr, "Shared hash tables are not supported on this platform\n");
+	return 1;
+}
+
+#endif
+
+void transposition_prune(int depth) {
+	int i;
+	int kept = 0;
+	int removed = 0;
+
+	for (i = 0; i < ENTRIES; i++) {
+		unsigned long long data = table[i].data;
+
+		if (DATA_EVAL_TYPE(data) == EVAL_NONE)
+			continue;
+
+		if (DATA_DEPTH(data) < depth || DATA_EVAL_TYPE(data) == EVAL_PV) {
+			table[i].key = 0;
+			table[i].data = 0;
+			removed++;
+		} else
+			kept++;
+	}
+
+	printf("Hash table pruned: %i entries kept, %i entries removed\n", kept, removed);
+}
+
 void transposition_exit(void) {
+#ifndef _WIN32
+	if (shm_name) {
+		detach_shm();
+		return;
+	}
+
+	if (file_header) {
+		munmap(file_header, file_size);
+		file_header = NULL;
+		return;
+	}
+#endif
 	free(table);
+	table = NULL;
 }
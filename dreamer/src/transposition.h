@@ -29,15 +29,52 @@
 #define EVAL_UPPERBOUND 3
 #define EVAL_PV 4
 
-void store_board(board_t *board, int eval, int eval_type, int depth, int ply, int time_stamp, move_t best_move);
+/* Depth at which results of the quiescence search are stored. */
+#define DEPTH_QUIESCENCE -1
+
+void store_board(board_t *board, int eval, int eval_type, int depth, int ply, move_t best_move);
 
 int lookup_board(board_t *board, int depth, int ply, int *eval);
 
 void set_best_move(board_t *board, move_t move);
 
+void transposition_stats(long long *probes, long long *hits);
+/* Retrieves and resets the lookup statistics of the calling thread.
+** Parameters: (long long *) probes: Receives the number of lookups.
+**             (long long *) hits: Receives the number of lookups that
+**                 found an entry of the board, deep enough or not.
+** Returns   : (void)
+*/
+
 void clear_table(void);
 
 void transposition_init(int megabytes);
+
+int transposition_init_file(const char *filename, int megabytes);
+/* Maps the hash table onto a file, so that its contents survive engine
+** restarts. An existing file is reused when it was written with the same
+** Zobrist seed and entry format, otherwise it is reinitialized.
+** Parameters: (const char *) filename: The hash table file.
+**             (int) megabytes: Size of the table when a new file is created.
+** Returns   : (int): 0 on success, 1 on failure.
+*/
+
+int transposition_init_shm(const char *name, int megabytes);
+/* Attaches to a hash table in POSIX shared memory, creating it when no other
+** process has done so yet. The table is removed when the last process
+** detaches.
+** Parameters: (const char *) name: Name of the shared memory object.
+**             (int) megabytes: Size of the table when it is created.
+** Returns   : (int): 0 on success, 1 on failure.
+*/
+
+void transposition_prune(int depth);
+/* Removes all entries that were searched to less than a given depth. The
+** table keeps its size.
+** Parameters: (int) depth: Minimum depth of the entries to keep.
+** Returns   : (void)
+*/
+
 void transposition_exit(void);
 move_t lookup_best_move(board_t *board);
 
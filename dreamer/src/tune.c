@@ -0,0 +1,413 @@
+/*  DreamChess
+**
+**  DreamChess is the legal property of its developers, whose names are too
+**  numerous to list here. Please refer to the AUTHORS.txt file distributed
+**  with this source distribution.
+**
+**  This program is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "board.h"
+#include "eval.h"
+#include "move.h"
+#include "thread.h"
+#include "tune.h"
+
+/* Maximum depth of the capture search that finds the quiet positions. */
+#define TUNE_MAX_PLY 16
+
+/* Maximum number of threads used to compute the error. */
+#define TUNE_THREADS 64
+
+/* Bounds of the capture search window. */
+#define TUNE_SCORE_MAX 100000
+
+/* Training positions. */
+typedef struct tune_data {
+	eval_positions_t positions;
+
+	/* Game result of each position for white: 0 loss, 1 draw, 2 win. */
+	unsigned char *results;
+
+	/* Number of results that fit in the array. */
+	int size;
+} tune_data_t;
+
+/* Range of positions handled by one thread. */
+typedef struct tune_job {
+	tune_data_t *data;
+	int *scores;
+	double k;
+	int first;
+	int last;
+	double error;
+} tune_job_t;
+
+static move_t pv[TUNE_MAX_PLY][TUNE_MAX_PLY];
+static int pv_len[TUNE_MAX_PLY];
+
+static int quiesce(board_t *board, int ply, int alpha, int beta) {
+	/* Capture search that records its principal variation. The legal
+	** moves of the board must have been computed for ply.
+	*/
+	bitboard_t en_passant = board->en_passant;
+	int castle_flags = board->castle_flags;
+	int fifty_moves = board->fifty_moves;
+	int start = moves_start[ply];
+	int end = moves_start[ply + 1];
+	int eval;
+	int i;
+
+	pv_len[ply] = 0;
+
+	eval = board_eval_complete(board, board->current_player, alpha, beta);
+
+	if (ply == TUNE_MAX_PLY - 1 || eval >= beta)
+		return eval;
+
+	if (eval > alpha)
+		alpha = eval;
+
+	for (i = start; i < end; i++) {
+		move_t move = moves[i];
+
+		if (!(move & (CAPTURE_MOVE | CAPTURE_MOVE_EN_PASSANT | MOVE_PROMOTION_MASK)))
+			continue;
+
+		execute_move(board, move);
+
+		if (compute_legal_moves(board, ply + 1) < 0) {
+			unmake_move(board, move, en_passant, castle_flags, fifty_moves);
+			continue;
+		}
+
+		eval = -quiesce(board, ply + 1, -beta, -alpha);
+		unmake_move(board, move, en_passant, castle_flags, fifty_moves);
+
+		if (eval >= beta)
+			return beta;
+
+		if (eval > alpha) {
+			alpha = eval;
+			pv[ply][0] = move;
+			memcpy(pv[ply] + 1, pv[ply + 1], pv_len[ply + 1] * sizeof(move_t));
+			pv_len[ply] = pv_len[ply + 1] + 1;
+		}
+	}
+
+	return alpha;
+}
+
+static int parse_result(const char *s) {
+	/* Finds the game result for white in the remainder of a data line.
+	** Returns 0 for a loss, 1 for a draw, 2 for a win, or -1 if there is
+	** none.
+	*/
+	const char *bracket;
+
+	if (strstr(s, "1/2-1/2"))
+		return 1;
+	if (strstr(s, "1-0"))
+		return 2;
+	if (strstr(s, "0-1"))
+		return 0;
+
+	bracket = strchr(s, '[');
+	if (bracket) {
+		double result = atof(bracket + 1);
+
+		if (result == 1.0)
+			return 2;
+		if (result == 0.5)
+			return 1;
+		if (result == 0.0 && bracket[1] == '0')
+			return 0;
+	}
+
+	return -1;
+}
+
+static int add_position(tune_data_t *data, board_t *board, int result) {
+	eval_positions_t *positions = &data->positions;
+
+	if (eval_positions_add(positions, board))
+		return -1;
+
+	if (data->size != positions->size) {
+		unsigned char *results = realloc(data->results, positions->size);
+
+		if (!results)
+			return -1;
+
+		data->results = results;
+		data->size = positions->size;
+	}
+
+	data->results[positions->count - 1] = result;
+
+	return 0;
+}
+
+static int load_data(tune_data_t *data, const char *filename) {
+	FILE *f = fopen(filename, "r");
+	char line[1024];
+	int skipped = 0;
+
+	if (!f) {
+		fprintf(stderr, "Failed to open data file '%s'\n", filename);
+		return -1;
+	}
+
+	while (fgets(line, sizeof(line), f)) {
+		char fen[420];
+		char fields[4][100];
+		int consumed;
+		int result;
+		board_t board;
+		int i;
+
+		if (sscanf(line, "%99s %99s %99s %99s%n", fields[0], fields[1], fields[2], fields[3], &consumed) != 4 ||
+			(result = parse_result(line + consumed)) < 0) {
+			skipped++;
+			continue;
+		}
+
+		sprintf(fen, "%s %s %s %s 0 1", fields[0], fields[1], fields[2], fields[3]);
+
+		if (setup_board_fen(&board, fen) || compute_legal_moves(&board, 0) < 0) {
+			skipped++;
+			continue;
+		}
+
+		/* Replace the position by the end of its capture sequence. */
+		quiesce(&board, 0, -TUNE_SCORE_MAX, TUNE_SCORE_MAX);
+
+		for (i = 0; i < pv_len[0]; i++)
+			execute_move(&board, pv[0][i]);
+
+		if (add_position(data, &board, result)) {
+			fprintf(stderr, "Out of memory\n");
+			fclose(f);
+			return -1;
+		}
+	}
+
+	fclose(f);
+
+	fprintf(stderr, "Loaded %i positions", data->positions.count);
+	if (skipped)
+		fprintf(stderr, ", skipped %i lines", skipped);
+	fprintf(stderr, "\n");
+
+	return data->positions.count > 0 ? 0 : -1;
+}
+
+static void free_data(tune_data_t *data) {
+	eval_positions_free(&data->positions);
+	free(data->results);
+}
+
+static double squared_error(tune_data_t *data, int *scores, double k, int first, int last) {
+	/* Sum of the squared differences between the results and the winning
+	** chances of white predicted from the scores.
+	*/
+	double error = 0.0;
+	int i;
+
+	for (i = first; i < last; i++) {
+		int score = scores[i];
+		double difference;
+
+		if (data->positions.current_player[i] == SIDE_BLACK)
+			score = -score;
+
+		difference = data->results[i] * 0.5 - 1.0 / (1.0 + pow(10.0, -k * score / 400.0));
+		error += difference * difference;
+	}
+
+	return error;
+}
+
+static int tune_thread(void *arg) {
+	tune_job_t *job = arg;
+
+	eval_batch(&job->data->positions, job->first, job->last, job->scores, 1);
+	job->error = squared_error(job->data, job->scores, job->k, job->first, job->last);
+
+	return 0;
+}
+
+static double mean_error(tune_data_t *data, int *scores, double k, int threads) {
+	/* Evaluates all positions with the current weights and returns the
+	** mean squared error. The scores are stored for fit_k().
+	*/
+	tune_job_t jobs[TUNE_THREADS];
+	thread_t *handles[TUNE_THREADS];
+	double error = 0.0;
+	int count = data->positions.count;
+	int i;
+
+	for (i = 0; i < threads; i++) {
+		jobs[i].data = data;
+		jobs[i].scores = scores;
+		jobs[i].k = k;
+		jobs[i].first = (int)((long long)count * i / threads);
+		jobs[i].last = (int)((long long)count * (i + 1) / threads);
+	}
+
+	for (i = 1; i < threads; i++)
+		handles[i] = thread_create(tune_thread, &jobs[i]);
+
+	tune_thread(&jobs[0]);
+
+	for (i = 1; i < threads; i++) {
+		if (handles[i])
+			thread_join(handles[i]);
+		else
+			tune_thread(&jobs[i]);
+	}
+
+	for (i = 0; i < threads; i++)
+		error += jobs[i].error;
+
+	return error / count;
+}
+
+static double fit_k(tune_data_t *data, int *scores) {
+	/* Finds the scaling constant that best maps the scores of the initial
+	** weights to the results, with a coarse scan followed by a fine one.
+	*/
+	double best_k = 1.0;
+	double best_error = 2.0;
+	double step = 0.05;
+	double low = step;
+	double high = 3.0;
+	int pass;
+
+	for (pass = 0; pass < 2; pass++) {
+		double k;
+
+		for (k = low; k <= high; k += step) {
+			double error = squared_error(data, scores, k, 0, data->positions.count) / data->positions.count;
+
+			if (error < best_error) {
+				best_error = error;
+				best_k = k;
+			}
+		}
+
+		low = best_k - step;
+		high = best_k + step;
+		step /= 50;
+	}
+
+	return best_k;
+}
+
+int tune(const char *filename) {
+	tune_data_t data;
+	int *scores;
+	int *steps;
+	int nr_params = eval_param_count();
+	int threads = thread_cpu_count();
+	double best_error;
+	double k;
+	int pass;
+	int i;
+
+	memset(&data, 0, sizeof(data));
+
+	if (threads > TUNE_THREADS)
+		threads = TUNE_THREADS;
+
+	if (load_data(&data, filename)) {
+		free_data(&data);
+		return -1;
+	}
+
+	scores = malloc(data.positions.count * sizeof(int));
+	steps = malloc(nr_params * sizeof(int));
+
+	if (!scores || !steps) {
+		fprintf(stderr, "Out of memory\n");
+		free(scores);
+		free(steps);
+		free_data(&data);
+		return -1;
+	}
+
+	mean_error(&data, scores, 1.0, threads);
+	k = fit_k(&data, scores);
+	best_error = mean_error(&data, scores, k, threads);
+
+	fprintf(stderr, "Using K = %.3f, error %.8f, %i thread(s)\n", k, best_error, threads);
+
+	/* Start with steps of about a tenth of each weight. */
+	for (i = 0; i < nr_params; i++) {
+		steps[i] = abs(eval_get_param(i)) / 10;
+		if (steps[i] < 1)
+			steps[i] = 1;
+	}
+
+	/* Local search: a weight keeps moving in steps while that lowers the
+	** error. Otherwise its step is halved, until steps of 1 in both
+	** directions fail for all weights.
+	*/
+	for (pass = 1;; pass++) {
+		int progress = 0;
+
+		for (i = 0; i < nr_params; i++) {
+			int value = eval_get_param(i);
+			double error;
+
+			eval_set_param(i, value + steps[i]);
+			error = mean_error(&data, scores, k, threads);
+
+			if (error >= best_error) {
+				eval_set_param(i, value - steps[i]);
+				error = mean_error(&data, scores, k, threads);
+			}
+
+			if (error < best_error) {
+				best_error = error;
+				progress = 1;
+			} else {
+				eval_set_param(i, value);
+				if (steps[i] > 1) {
+					steps[i] /= 2;
+					progress = 1;
+				}
+			}
+		}
+
+		fprintf(stderr, "Pass %i: error %.8f\n", pass, best_error);
+
+		if (!progress)
+			break;
+	}
+
+	printf("# Tuned on %i positions from '%s', error %.8f\n", data.positions.count, filename, best_error);
+	for (i = 0; i < nr_params; i++)
+		printf("%s %i\n", eval_param_name(i), eval_get_param(i));
+
+	free(scores);
+	free(steps);
+	free_data(&data);
+	return 0;
+}
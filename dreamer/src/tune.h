@@ -0,0 +1,39 @@
+/*  DreamChess
+**
+**  DreamChess is the legal property of its developers, whose names are too
+**  numerous to list here. Please refer to the AUTHORS.txt file distributed
+**  with this source distribution.
+**
+**  This program is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef DREAMER_TUNE_H
+#define DREAMER_TUNE_H
+
+int tune(const char *filename);
+/* Tunes the evaluation weights to a set of positions from played games,
+** minimising the squared difference between the game results and the
+** winning chances predicted from the evaluation of the quiet position
+** reached by a capture search from each position. The tuned weights are
+** written to standard output in the format read by eval_load_params().
+**
+** Every line of the data file holds a position in FEN (only the first
+** four fields are used) followed by the result for white, either as
+** "1-0", "0-1" and "1/2-1/2", or as [1.0], [0.0] and [0.5].
+**
+** Parameters: (const char *) filename: Path of the data file.
+** Returns   : (int): 0 on success, -1 on error.
+*/
+
+#endif